@@ -8,13 +8,81 @@
 // Таймаут HTTP-запроса (секунды)
 #define HTTP_TIMEOUT 30
 
+// Регулятор загрузок: запросов в секунду к одному хосту
+#define GOV_RATE 2.0
+
+// Нижняя граница скорости после 429/503 (запросов в секунду)
+#define GOV_MIN_RATE 0.05
+
+// Допустимый всплеск запросов к хосту (ёмкость token bucket)
+#define GOV_BURST 4
+
+// Одновременных запросов к одному хосту
+#define GOV_MAX_INFLIGHT 4
+
+// Экспоненциальный откат при 429/503 без Retry-After (мс)
+#define GOV_BACKOFF_BASE_MS 1000
+#define GOV_BACKOFF_MAX_MS 300000
+
+// Повторов запроса после 429/503
+#define GOV_MAX_RETRIES 3
+
 // Макс. серверов от одного сайта (защита от флуда)
 #define MAX_SERVERS_PER_SITE 50
 
 // TTL записей в Redis (секунды)
 #define REDIS_TTL 86400  // 24 часа
 
+// Архив истории в MongoDB
+#define MONGO_URI "mongodb://127.0.0.1:27017/?serverSelectionTimeoutMS=2000"
+#define MONGO_DB "vpn"
+#define MONGO_ARCHIVE_COLLECTION "server_history"
+
+// Сколько дней хранить историю (TTL-индекс по дню bucket'а)
+#define ARCHIVE_RETENTION_DAYS 90
+
+// Очередь наблюдений в памяти и размер одной bulk-записи
+#define ARCHIVE_QUEUE_MAX 20000
+#define ARCHIVE_BATCH_MAX 1000
+
+// Потолок наблюдений в одном суточном bucket'е
+#define ARCHIVE_MAX_SAMPLES 1440
+
+// Пауза между попытками подключиться/записать, пока MongoDB недоступна (секунды)
+#define ARCHIVE_RETRY_SEC 30
+
+// Пакетный ввод-вывод (io_uring): размер кольца и таблицы фиксированных дескрипторов
+#define IO_RING_ENTRIES 256
+#define IO_RING_FILES 64
+
+// Зарегистрированный буфер для записи конфигов (байты)
+#define IO_RING_ARENA (1 << 20)
+
+// Сколько сохранений копить до принудительной отправки
+#define IO_BATCH_MAX 256
+
+// Таймаут проверки доступности сервера (мс)
+#define PROBE_TIMEOUT_MS 5000
+
 // Путь к директории ресурсов (если понадобится)
 #define RESOURCE_DIR "source/daemon/resource"
 
+// Кластерный режим (VPN_CLUSTER=1): аренда выполненной работы (мс) — один цикл
+#define CLUSTER_LEASE_MS ((long long)SCAN_INTERVAL * 1000)
+
+// Короткая аренда на время выполнения работы (мс)
+#define CLUSTER_WORK_MS 600000
+
+// Срок жизни heartbeat узла (мс): пропустил — считается мёртвым
+#define CLUSTER_NODE_TTL_MS 90000
+
+// Как часто узел проверяет, нет ли для него работы (секунды)
+#define CLUSTER_TICK 30
+
+// Как часто фоновый поток продлевает heartbeat (секунды), в т.ч. во время долгой загрузки
+#define CLUSTER_KEEPALIVE_SEC 10
+
+// Число шардов проверки доступности серверов
+#define CLUSTER_PROBE_SHARDS 16
+
 #endif
\ No newline at end of file
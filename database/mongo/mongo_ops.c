@@ -0,0 +1,387 @@
+// database/mongo/mongo_ops.c
+#include "mongo_ops.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <mongoc/mongoc.h>
+
+#include "../../config/config.h"
+
+typedef struct {
+    char site[32];
+    char ip[46];
+    int port;
+    char proto[8];
+    char country[48];
+    double score;
+    int64_t t_ms;
+} archive_obs_t;
+
+static char archive_uri[512];
+static mongoc_client_t *client;
+static mongoc_collection_t *collection;
+
+// Кольцевая очередь наблюдений между циклом сканирования и фоновым потоком
+static archive_obs_t *queue;
+static size_t q_head, q_len;
+static size_t dropped;
+static int flush_requested;
+static int stopping;
+static int running;
+static int mongoc_ready;
+
+static pthread_t writer;
+static pthread_mutex_t q_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t q_cond = PTHREAD_COND_INITIALIZER;
+
+// TTL-индекс по day; если срок хранения поменяли — обновляем через collMod
+static int ensure_ttl_index(mongoc_database_t *db) {
+    bson_error_t error;
+    bson_t reply;
+    int64_t ttl = (int64_t)ARCHIVE_RETENTION_DAYS * 86400;
+
+    bson_t *cmd = BCON_NEW(
+        "createIndexes", BCON_UTF8(MONGO_ARCHIVE_COLLECTION),
+        "indexes", "[", "{",
+            "key", "{", "day", BCON_INT32(1), "}",
+            "name", BCON_UTF8("day_ttl"),
+            "expireAfterSeconds", BCON_INT64(ttl),
+        "}", "]");
+    bool ok = mongoc_database_write_command_with_opts(db, cmd, NULL, &reply, &error);
+    bson_destroy(cmd);
+    bson_destroy(&reply);
+    if (ok) return 0;
+
+    // 85 = IndexOptionsConflict: индекс есть, но с другим сроком
+    if (error.code != 85) {
+        fprintf(stderr, "[-] Mongo createIndexes failed: %s\n", error.message);
+        return -1;
+    }
+
+    cmd = BCON_NEW(
+        "collMod", BCON_UTF8(MONGO_ARCHIVE_COLLECTION),
+        "index", "{",
+            "name", BCON_UTF8("day_ttl"),
+            "expireAfterSeconds", BCON_INT64(ttl),
+        "}");
+    ok = mongoc_database_write_command_with_opts(db, cmd, NULL, &reply, &error);
+    bson_destroy(cmd);
+    bson_destroy(&reply);
+    if (!ok) {
+        fprintf(stderr, "[-] Mongo collMod failed: %s\n", error.message);
+        return -1;
+    }
+    return 0;
+}
+
+// Ошибки отдельных операций (reply.writeErrors): в лог первую и общее число
+static size_t log_write_errors(const bson_t *reply) {
+    bson_iter_t iter, errors;
+    size_t count = 0;
+
+    if (!bson_iter_init_find(&iter, reply, "writeErrors") ||
+        !BSON_ITER_HOLDS_ARRAY(&iter) || !bson_iter_recurse(&iter, &errors)) {
+        return 0;
+    }
+    while (bson_iter_next(&errors)) {
+        bson_iter_t msg;
+        if (count == 0 && bson_iter_recurse(&errors, &msg) &&
+            bson_iter_find(&msg, "errmsg") && BSON_ITER_HOLDS_UTF8(&msg)) {
+            fprintf(stderr, "[-] Mongo write error: %s\n", bson_iter_utf8(&msg, NULL));
+        }
+        count++;
+    }
+    return count;
+}
+
+// Возвращает число отброшенных наблюдений или -1, если пачку надо повторить
+static int write_batch(const archive_obs_t *batch, size_t n) {
+    bson_error_t error;
+    bson_t reply;
+
+    bson_t *opts = BCON_NEW("ordered", BCON_BOOL(false));
+    mongoc_bulk_operation_t *bulk = mongoc_collection_create_bulk_operation_with_opts(collection, opts);
+    bson_destroy(opts);
+
+    bson_t *upsert = BCON_NEW("upsert", BCON_BOOL(true));
+
+    for (size_t i = 0; i < n; i++) {
+        const archive_obs_t *o = &batch[i];
+
+        time_t secs = (time_t)(o->t_ms / 1000);
+        struct tm tm;
+        gmtime_r(&secs, &tm);
+        int64_t day_ms = (o->t_ms / 86400000) * 86400000;
+
+        char id[192];
+        snprintf(id, sizeof(id), "%s:%s:%d:%s:%04d%02d%02d",
+                 o->site, o->ip, o->port, o->proto,
+                 tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+
+        bson_t *selector = BCON_NEW("_id", BCON_UTF8(id));
+        bson_t *update = BCON_NEW(
+            "$setOnInsert", "{",
+                "site", BCON_UTF8(o->site),
+                "ip", BCON_UTF8(o->ip),
+                "port", BCON_INT32(o->port),
+                "proto", BCON_UTF8(o->proto),
+                "day", BCON_DATE_TIME(day_ms),
+            "}",
+            "$set", "{", "country", BCON_UTF8(o->country), "}",
+            "$min", "{", "first_seen", BCON_DATE_TIME(o->t_ms), "}",
+            "$max", "{", "last_seen", BCON_DATE_TIME(o->t_ms), "}",
+            "$inc", "{", "n", BCON_INT32(1), "}",
+            "$push", "{", "samples", "{",
+                "$each", "[", "{",
+                    "t", BCON_DATE_TIME(o->t_ms),
+                    "score", BCON_DOUBLE(o->score),
+                "}", "]",
+                "$slice", BCON_INT32(-ARCHIVE_MAX_SAMPLES),
+            "}", "}");
+
+        if (!mongoc_bulk_operation_update_one_with_opts(bulk, selector, update, upsert, &error)) {
+            fprintf(stderr, "[-] Mongo bulk append failed: %s\n", error.message);
+        }
+        bson_destroy(selector);
+        bson_destroy(update);
+    }
+
+    int rc = 0;
+    if (!mongoc_bulk_operation_execute(bulk, &reply, &error)) {
+        if (error.domain == MONGOC_ERROR_STREAM || error.domain == MONGOC_ERROR_SERVER_SELECTION) {
+            // До сервера пачка не дошла (или связь оборвалась) — повторим после переподключения
+            fprintf(stderr, "[-] Mongo bulk write failed: %s\n", error.message);
+            rc = -1;
+        } else {
+            // Неупорядоченный bulk применил всё, кроме отвергнутых операций: повтор
+            // продублировал бы $inc и $push у применённых, поэтому отвергнутые отбрасываем
+            size_t failed = log_write_errors(&reply);
+            fprintf(stderr, "[-] Mongo bulk write: %zu of %zu observations rejected: %s\n",
+                    failed, n, error.message);
+            rc = (int)failed;
+        }
+    }
+
+    bson_destroy(&reply);
+    bson_destroy(upsert);
+    mongoc_bulk_operation_destroy(bulk);
+    return rc;
+}
+
+// Подключение и проверка доступности — только из фонового потока: ping ждёт
+// до serverSelectionTimeoutMS, и цикл сканирования этого видеть не должен
+static int archive_connect(void) {
+    bson_error_t error;
+    mongoc_uri_t *muri = mongoc_uri_new_with_error(archive_uri, &error);
+    if (!muri) {
+        fprintf(stderr, "[-] Bad Mongo URI: %s\n", error.message);
+        return -1;
+    }
+    client = mongoc_client_new_from_uri(muri);
+    mongoc_uri_destroy(muri);
+    if (!client) return -1;
+    mongoc_client_set_appname(client, "vpn_parser");
+
+    bson_t *ping = BCON_NEW("ping", BCON_INT32(1));
+    bool ok = mongoc_client_command_simple(client, "admin", ping, NULL, NULL, &error);
+    bson_destroy(ping);
+    if (!ok) {
+        fprintf(stderr, "[-] Mongo connection error: %s\n", error.message);
+        mongoc_client_destroy(client);
+        client = NULL;
+        return -1;
+    }
+
+    mongoc_database_t *db = mongoc_client_get_database(client, MONGO_DB);
+    ensure_ttl_index(db);
+    mongoc_database_destroy(db);
+
+    collection = mongoc_client_get_collection(client, MONGO_DB, MONGO_ARCHIVE_COLLECTION);
+    printf("[+] Connected to MongoDB archive\n");
+    return 0;
+}
+
+static void archive_disconnect(void) {
+    if (collection) mongoc_collection_destroy(collection);
+    if (client) mongoc_client_destroy(client);
+    collection = NULL;
+    client = NULL;
+}
+
+// Ждём ARCHIVE_RETRY_SEC или остановки; q_mutex захвачен
+static void wait_retry(void) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ARCHIVE_RETRY_SEC;
+    while (!stopping && pthread_cond_timedwait(&q_cond, &q_mutex, &deadline) != ETIMEDOUT) {
+    }
+}
+
+// Возвращает незаписанную пачку в голову очереди; что не влезло — теряется.
+// q_mutex захвачен
+static void requeue(const archive_obs_t *batch, size_t n) {
+    size_t room = ARCHIVE_QUEUE_MAX - q_len;
+    size_t keep = n < room ? n : room;
+
+    q_head = (q_head + ARCHIVE_QUEUE_MAX - keep) % ARCHIVE_QUEUE_MAX;
+    for (size_t i = 0; i < keep; i++) {
+        queue[(q_head + i) % ARCHIVE_QUEUE_MAX] = batch[i];
+    }
+    q_len += keep;
+    dropped += n - keep;
+}
+
+static void *writer_thread(void *arg) {
+    (void)arg;
+    archive_obs_t *batch = malloc(sizeof(archive_obs_t) * ARCHIVE_BATCH_MAX);
+    if (!batch) return NULL;
+
+    pthread_mutex_lock(&q_mutex);
+    for (;;) {
+        // Пока MongoDB недоступна, наблюдения копятся в очереди (до ARCHIVE_QUEUE_MAX)
+        if (!collection) {
+            if (stopping) break;
+            pthread_mutex_unlock(&q_mutex);
+            int rc = archive_connect();
+            pthread_mutex_lock(&q_mutex);
+            if (rc != 0) {
+                wait_retry();
+                continue;
+            }
+        }
+
+        while (!stopping && !flush_requested && q_len < ARCHIVE_BATCH_MAX) {
+            pthread_cond_wait(&q_cond, &q_mutex);
+        }
+        if (q_len == 0) {
+            flush_requested = 0;
+            if (stopping) break;
+            continue;
+        }
+
+        // Забираем пачку и пишем без блокировки — цикл сканирования продолжает добавлять
+        size_t n = q_len < ARCHIVE_BATCH_MAX ? q_len : ARCHIVE_BATCH_MAX;
+        for (size_t i = 0; i < n; i++) {
+            batch[i] = queue[(q_head + i) % ARCHIVE_QUEUE_MAX];
+        }
+        q_head = (q_head + n) % ARCHIVE_QUEUE_MAX;
+        q_len -= n;
+        size_t lost = dropped;
+        dropped = 0;
+        pthread_mutex_unlock(&q_mutex);
+
+        if (lost) {
+            fprintf(stderr, "[-] Archive queue overflow: %zu observations dropped\n", lost);
+        }
+        int rc = write_batch(batch, n);
+        if (rc >= 0) {
+            printf("[+] Archived %zu observations\n", n - (size_t)rc);
+        } else {
+            // MongoDB пропала: переподключимся с ping'ом через паузу
+            archive_disconnect();
+        }
+
+        pthread_mutex_lock(&q_mutex);
+        if (rc < 0) {
+            requeue(batch, n);
+            wait_retry();
+        }
+    }
+    pthread_mutex_unlock(&q_mutex);
+
+    free(batch);
+    return NULL;
+}
+
+int mongo_archive_start(const char *uri) {
+    if (running) return 0;
+
+    // mongoc_init() допускается один раз на процесс
+    if (!mongoc_ready) {
+        mongoc_init();
+        mongoc_ready = 1;
+    }
+    snprintf(archive_uri, sizeof(archive_uri), "%s", uri);
+
+    queue = calloc(ARCHIVE_QUEUE_MAX, sizeof(archive_obs_t));
+    if (!queue) return -1;
+    q_head = q_len = dropped = 0;
+    flush_requested = stopping = 0;
+
+    if (pthread_create(&writer, NULL, writer_thread, NULL) != 0) {
+        free(queue);
+        queue = NULL;
+        return -1;
+    }
+
+    running = 1;
+    return 0;
+}
+
+void mongo_archive_record(
+    const char *site,
+    const char *ip,
+    int port,
+    const char *proto,
+    const char *country,
+    double score
+) {
+    if (!running || !site || !ip || !proto) return;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    pthread_mutex_lock(&q_mutex);
+    if (q_len == ARCHIVE_QUEUE_MAX) {
+        dropped++;
+        pthread_mutex_unlock(&q_mutex);
+        return;
+    }
+
+    archive_obs_t *o = &queue[(q_head + q_len) % ARCHIVE_QUEUE_MAX];
+    snprintf(o->site, sizeof(o->site), "%s", site);
+    snprintf(o->ip, sizeof(o->ip), "%s", ip);
+    o->port = port;
+    snprintf(o->proto, sizeof(o->proto), "%s", proto);
+    snprintf(o->country, sizeof(o->country), "%s", country ? country : "??");
+    o->score = score;
+    o->t_ms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    q_len++;
+
+    if (q_len >= ARCHIVE_BATCH_MAX) pthread_cond_signal(&q_cond);
+    pthread_mutex_unlock(&q_mutex);
+}
+
+void mongo_archive_flush(void) {
+    if (!running) return;
+
+    pthread_mutex_lock(&q_mutex);
+    flush_requested = 1;
+    pthread_cond_signal(&q_cond);
+    pthread_mutex_unlock(&q_mutex);
+}
+
+void mongo_archive_stop(void) {
+    if (!running) return;
+
+    pthread_mutex_lock(&q_mutex);
+    stopping = 1;
+    pthread_cond_signal(&q_cond);
+    pthread_mutex_unlock(&q_mutex);
+    pthread_join(writer, NULL);
+
+    if (q_len) {
+        fprintf(stderr, "[-] Archive stopped with %zu observations unsaved\n", q_len);
+    }
+    archive_disconnect();
+    free(queue);
+    queue = NULL;
+    running = 0;
+    mongoc_cleanup();
+    mongoc_ready = 0;
+}
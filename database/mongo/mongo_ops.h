@@ -0,0 +1,59 @@
+// database/mongo/mongo_ops.h
+#ifndef MONGO_OPS_H
+#define MONGO_OPS_H
+
+/**
+ * @brief Архив истории серверов в MongoDB.
+ *
+ * Redis хранит только последние 24 часа; сюда складывается вся история.
+ * Один документ на сервер в сутки (bucket), наблюдения — элементы массива samples:
+ *
+ *   _id:        "<site>:<ip>:<port>:<proto>:<YYYYMMDD>"
+ *   site, ip, port, proto, country, day (полночь UTC)
+ *   first_seen, last_seen, n
+ *   samples:    [{t, score}, ...]
+ *
+ * Подключение и запись идут из фонового потока (неупорядоченные bulk-upsert'ы),
+ * поэтому цикл сканирования никогда не ждёт MongoDB. Пока она недоступна, поток
+ * переподключается раз в ARCHIVE_RETRY_SEC, а наблюдения копятся в очереди;
+ * неудачная пачка возвращается в очередь. Срок хранения задаётся
+ * ARCHIVE_RETENTION_DAYS через TTL-индекс по полю day.
+ */
+
+/**
+ * @brief Запускает фоновый поток архива. Не ходит в сеть и не блокируется.
+ *
+ * Подключение, ping и создание TTL-индекса выполняет сам поток.
+ * Повторный вызов при запущенном архиве ничего не делает.
+ *
+ * @param uri — строка подключения (например, "mongodb://127.0.0.1:27017")
+ * @return 0 при успехе, -1 при ошибке (нет памяти или потока)
+ */
+int mongo_archive_start(const char *uri);
+
+/**
+ * @brief Ставит наблюдение в очередь архива. Не блокируется на сети.
+ *
+ * Если архив не запущен — ничего не делает. Если очередь переполнена,
+ * наблюдение отбрасывается (учитывается в логе при следующей записи).
+ */
+void mongo_archive_record(
+    const char *site,
+    const char *ip,
+    int port,
+    const char *proto,
+    const char *country,
+    double score
+);
+
+/**
+ * @brief Сообщает о конце цикла: накопленное будет записано одной пачкой.
+ */
+void mongo_archive_flush(void);
+
+/**
+ * @brief Дописывает очередь (если MongoDB доступна), останавливает поток и закрывает подключение.
+ */
+void mongo_archive_stop(void);
+
+#endif
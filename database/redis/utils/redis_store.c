@@ -62,4 +62,54 @@ int redis_save_vpn_server(
     redisCommand(c, "EXPIRE %s 86400", key);
     freeReplyObject(reply);
     return 0;
-}
\ No newline at end of file
+}
+
+// Запись под арендой: чужой токен в ключе аренды — ничего не пишем
+static const char *LUA_FENCED_SAVE =
+    "if redis.call('GET', KEYS[1]) ~= ARGV[1] then return 0 end "
+    "redis.call('HSET', KEYS[2], 'ip', ARGV[2], 'port', ARGV[3], 'protocol', ARGV[4], "
+    "'country', ARGV[5], 'score', ARGV[6], 'last_seen', ARGV[7], 'config_url', ARGV[8]) "
+    "redis.call('EXPIRE', KEYS[2], 86400) "
+    "return 1";
+
+int redis_save_vpn_server_fenced(
+    redisContext *c,
+    const char *lease_key,
+    const char *lease_value,
+    const char *site,
+    const char *ip,
+    int port,
+    const char *proto,
+    const char *country,
+    double score,
+    const char *config_url
+) {
+    if (!c || !lease_key || !lease_value || !site || !ip || !proto || !config_url) {
+        return -1;
+    }
+
+    char key[256];
+    snprintf(key, sizeof(key), "vpn:servers:%s:%s:%d:%s", site, ip, port, proto);
+
+    time_t now = time(NULL);
+
+    redisReply *reply = redisCommand(c,
+        "EVAL %s 2 %s %s %s %s %d %s %s %f %ld %s",
+        LUA_FENCED_SAVE, lease_key, key, lease_value,
+        ip, port, proto, country ? country : "??", score, (long)now, config_url
+    );
+
+    if (!reply) {
+        fprintf(stderr, "[-] Redis command failed\n");
+        return -1;
+    }
+
+    int rc = -1;
+    if (reply->type == REDIS_REPLY_INTEGER) {
+        rc = reply->integer == 1;
+    } else if (reply->type == REDIS_REPLY_ERROR) {
+        fprintf(stderr, "[-] Redis error: %s\n", reply->str);
+    }
+    freeReplyObject(reply);
+    return rc;
+}
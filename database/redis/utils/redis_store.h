@@ -37,4 +37,27 @@ int redis_save_vpn_server(
     const char *config_url
 );
 
+/**
+ * @brief То же, что redis_save_vpn_server, но только пока аренда кластера наша.
+ *
+ * Проверка GET lease_key == lease_value и HSET выполняются одним скриптом Lua:
+ * узел, потерявший аренду между проверкой и записью, чужие данные не перезапишет.
+ *
+ * @param lease_key — ключ аренды (vpn:cluster:lease:<item>)
+ * @param lease_value — ожидаемое значение аренды (node_id:token)
+ * @return 1 — записано, 0 — аренда потеряна, -1 при ошибке
+ */
+int redis_save_vpn_server_fenced(
+    redisContext *c,
+    const char *lease_key,
+    const char *lease_value,
+    const char *site,
+    const char *ip,
+    int port,
+    const char *proto,
+    const char *country,
+    double score,
+    const char *config_url
+);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,414 @@
+// source/daemon/cluster/cluster.c
+#define _POSIX_C_SOURCE 200809L
+
+#include "cluster.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../../config/config.h"
+#include "../../../database/redis/utils/redis_store.h"
+
+#define CLUSTER_NODES_KEY "vpn:cluster:nodes"
+#define CLUSTER_FENCE_KEY "vpn:cluster:fence"
+#define CLUSTER_LEASE_PREFIX "vpn:cluster:lease:"
+#define CLUSTER_PROBE_PREFIX "vpn:cluster:probe:"
+
+// Compare-and-set по значению аренды: чужой токен не трогаем
+static const char *LUA_COMMIT =
+    "if redis.call('GET', KEYS[1]) == ARGV[1] then "
+    "return redis.call('PEXPIRE', KEYS[1], ARGV[2]) else return 0 end";
+
+// Продление аренды в работе: committed-аренду (PTTL больше CLUSTER_WORK_MS) не укорачиваем
+static const char *LUA_RENEW =
+    "if redis.call('GET', KEYS[1]) ~= ARGV[1] then return 0 end "
+    "if redis.call('PTTL', KEYS[1]) < tonumber(ARGV[2]) then "
+    "redis.call('PEXPIRE', KEYS[1], ARGV[2]) end "
+    "return 1";
+
+static const char *LUA_RELEASE =
+    "if redis.call('GET', KEYS[1]) == ARGV[1] then "
+    "return redis.call('DEL', KEYS[1]) else return 0 end";
+
+// HSET пар поле/значение из ARGV[3..] в KEYS[2], только пока KEYS[1] хранит нашу аренду
+static const char *LUA_PUBLISH =
+    "if redis.call('GET', KEYS[1]) ~= ARGV[1] then return 0 end "
+    "redis.call('HSET', KEYS[2], unpack(ARGV, 3)) "
+    "redis.call('PEXPIRE', KEYS[2], ARGV[2]) "
+    "return 1";
+
+int cluster_enabled(void) {
+    const char *v = getenv("VPN_CLUSTER");
+    return v && strcmp(v, "1") == 0;
+}
+
+// FNV-1a + финализатор splitmix64 — равномерный вес для HRW
+static uint64_t hrw_weight(const char *node, const char *item) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const char *p = node; *p; p++) {
+        h ^= (unsigned char)*p;
+        h *= 1099511628211ULL;
+    }
+    h ^= '|';
+    h *= 1099511628211ULL;
+    for (const char *p = item; *p; p++) {
+        h ^= (unsigned char)*p;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+static void free_members(cluster_t *cl) {
+    for (size_t i = 0; i < cl->member_count; i++) {
+        free(cl->members[i]);
+    }
+    free(cl->members);
+    cl->members = NULL;
+    cl->member_count = 0;
+}
+
+void cluster_lease_value(const cluster_t *cl, const cluster_lease_t *lease, char *buf, size_t len) {
+    snprintf(buf, len, "%s:%lld", cl->node_id, lease->token);
+}
+
+// Какую аренду продлевать потоку heartbeat (NULL — никакую)
+static void set_renewal(cluster_t *cl, const cluster_lease_t *lease) {
+    pthread_mutex_lock(&cl->keepalive_mutex);
+    if (lease) {
+        snprintf(cl->renew_key, sizeof(cl->renew_key), "%s", lease->key);
+        cluster_lease_value(cl, lease, cl->renew_value, sizeof(cl->renew_value));
+    } else {
+        cl->renew_key[0] = '\0';
+        cl->renew_value[0] = '\0';
+    }
+    pthread_mutex_unlock(&cl->keepalive_mutex);
+}
+
+// Время берём у Redis, а не у хоста — иначе рассинхрон часов ломает heartbeat
+static long long redis_now_ms(redisContext *c) {
+    redisReply *reply = redisCommand(c, "TIME");
+    if (!reply) return -1;
+
+    long long ms = -1;
+    if (reply->type == REDIS_REPLY_ARRAY && reply->elements == 2) {
+        ms = atoll(reply->element[0]->str) * 1000 + atoll(reply->element[1]->str) / 1000;
+    }
+    freeReplyObject(reply);
+    return ms;
+}
+
+// Только продление своей записи в ZSET и аренды в работе: список узлов перечитывает
+// основной поток. hiredis-контекст не потокобезопасен, поэтому подключение у потока своё.
+static void *keepalive_thread(void *arg) {
+    cluster_t *cl = (cluster_t *)arg;
+    redisContext *c = NULL;
+    char key[256], value[192];
+
+    pthread_mutex_lock(&cl->keepalive_mutex);
+    while (!cl->keepalive_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += CLUSTER_KEEPALIVE_SEC;
+        while (!cl->keepalive_stop &&
+               pthread_cond_timedwait(&cl->keepalive_cond, &cl->keepalive_mutex, &deadline) != ETIMEDOUT) {
+        }
+        if (cl->keepalive_stop) break;
+        memcpy(key, cl->renew_key, sizeof(key));
+        memcpy(value, cl->renew_value, sizeof(value));
+        pthread_mutex_unlock(&cl->keepalive_mutex);
+
+        if (c && c->err) {
+            redisFree(c);
+            c = NULL;
+        }
+        if (!c) c = redis_connect();
+
+        long long now = c ? redis_now_ms(c) : -1;
+        if (now >= 0) {
+            redisReply *reply = redisCommand(c, "ZADD %s %lld %s",
+                                             CLUSTER_NODES_KEY, now + CLUSTER_NODE_TTL_MS, cl->node_id);
+            if (reply) freeReplyObject(reply);
+        } else {
+            fprintf(stderr, "[-] Cluster: keepalive failed\n");
+        }
+
+        if (now >= 0 && key[0]) {
+            redisReply *reply = redisCommand(c, "EVAL %s 1 %s %s %d",
+                                             LUA_RENEW, key, value, CLUSTER_WORK_MS);
+            if (reply && reply->type == REDIS_REPLY_INTEGER && reply->integer == 0) {
+                fprintf(stderr, "[-] Cluster: lease %s taken over, cannot renew\n", key);
+            }
+            if (reply) freeReplyObject(reply);
+        }
+
+        pthread_mutex_lock(&cl->keepalive_mutex);
+    }
+    pthread_mutex_unlock(&cl->keepalive_mutex);
+
+    if (c) redisFree(c);
+    return NULL;
+}
+
+int cluster_init(cluster_t *cl) {
+    memset(cl, 0, sizeof(*cl));
+
+    char host[64];
+    if (gethostname(host, sizeof(host)) != 0) {
+        strcpy(host, "localhost");
+    }
+    host[sizeof(host) - 1] = '\0';
+    snprintf(cl->node_id, sizeof(cl->node_id), "%s:%d", host, (int)getpid());
+
+    cl->redis = redis_connect();
+    if (!cl->redis) return -1;
+
+    if (cluster_heartbeat(cl) != 0) {
+        redisFree(cl->redis);
+        cl->redis = NULL;
+        return -1;
+    }
+
+    pthread_mutex_init(&cl->keepalive_mutex, NULL);
+    pthread_cond_init(&cl->keepalive_cond, NULL);
+    if (pthread_create(&cl->keepalive, NULL, keepalive_thread, cl) != 0) {
+        pthread_mutex_destroy(&cl->keepalive_mutex);
+        pthread_cond_destroy(&cl->keepalive_cond);
+        redisFree(cl->redis);
+        cl->redis = NULL;
+        return -1;
+    }
+    cl->keepalive_running = 1;
+
+    printf("[+] Cluster node %s joined (%zu live nodes)\n", cl->node_id, cl->member_count);
+    return 0;
+}
+
+int cluster_heartbeat(cluster_t *cl) {
+    long long now = redis_now_ms(cl->redis);
+    if (now < 0) {
+        fprintf(stderr, "[-] Cluster: TIME failed\n");
+        return -1;
+    }
+
+    redisAppendCommand(cl->redis, "ZADD %s %lld %s",
+                       CLUSTER_NODES_KEY, now + CLUSTER_NODE_TTL_MS, cl->node_id);
+    redisAppendCommand(cl->redis, "ZREMRANGEBYSCORE %s -inf (%lld", CLUSTER_NODES_KEY, now);
+    redisAppendCommand(cl->redis, "ZRANGE %s 0 -1", CLUSTER_NODES_KEY);
+
+    redisReply *reply = NULL;
+    int rc = 0;
+    for (int i = 0; i < 3; i++) {
+        if (redisGetReply(cl->redis, (void **)&reply) != REDIS_OK || !reply) {
+            fprintf(stderr, "[-] Cluster: heartbeat failed\n");
+            return -1;
+        }
+        if (reply->type == REDIS_REPLY_ERROR) {
+            fprintf(stderr, "[-] Redis error: %s\n", reply->str);
+            rc = -1;
+        } else if (i == 2 && reply->type == REDIS_REPLY_ARRAY) {
+            free_members(cl);
+            cl->members = calloc(reply->elements ? reply->elements : 1, sizeof(char *));
+            if (cl->members) {
+                for (size_t j = 0; j < reply->elements; j++) {
+                    cl->members[cl->member_count] = strdup(reply->element[j]->str);
+                    if (cl->members[cl->member_count]) cl->member_count++;
+                }
+            }
+        }
+        freeReplyObject(reply);
+    }
+    return rc;
+}
+
+int cluster_is_owner(const cluster_t *cl, const char *item) {
+    // Пока не видим ни одного узла (в т.ч. себя) — работаем сами, SET NX всё равно разрулит
+    if (cl->member_count == 0) return 1;
+
+    const char *owner = NULL;
+    uint64_t best = 0;
+    for (size_t i = 0; i < cl->member_count; i++) {
+        uint64_t w = hrw_weight(cl->members[i], item);
+        if (!owner || w > best) {
+            best = w;
+            owner = cl->members[i];
+        }
+    }
+    return owner && strcmp(owner, cl->node_id) == 0;
+}
+
+int cluster_claim(cluster_t *cl, const char *item, cluster_lease_t *lease) {
+    snprintf(lease->key, sizeof(lease->key), CLUSTER_LEASE_PREFIX "%s", item);
+
+    // Дешёвая проверка до INCR, чтобы не жечь токены на занятых элементах
+    redisReply *reply = redisCommand(cl->redis, "EXISTS %s", lease->key);
+    if (!reply) return -1;
+    int busy = reply->type == REDIS_REPLY_INTEGER && reply->integer > 0;
+    freeReplyObject(reply);
+    if (busy) return 0;
+
+    reply = redisCommand(cl->redis, "INCR %s", CLUSTER_FENCE_KEY);
+    if (!reply) return -1;
+    if (reply->type != REDIS_REPLY_INTEGER) {
+        freeReplyObject(reply);
+        return -1;
+    }
+    lease->token = reply->integer;
+    freeReplyObject(reply);
+
+    char value[192];
+    cluster_lease_value(cl, lease, value, sizeof(value));
+
+    reply = redisCommand(cl->redis, "SET %s %s NX PX %d", lease->key, value, CLUSTER_WORK_MS);
+    if (!reply) return -1;
+
+    int claimed = 0;
+    if (reply->type == REDIS_REPLY_STATUS && strcmp(reply->str, "OK") == 0) {
+        claimed = 1;
+        set_renewal(cl, lease);
+    } else if (reply->type == REDIS_REPLY_ERROR) {
+        fprintf(stderr, "[-] Redis error: %s\n", reply->str);
+        claimed = -1;
+    }
+    freeReplyObject(reply);
+    return claimed;
+}
+
+int cluster_lease_valid(cluster_t *cl, const cluster_lease_t *lease) {
+    char value[192];
+    cluster_lease_value(cl, lease, value, sizeof(value));
+
+    redisReply *reply = redisCommand(cl->redis, "GET %s", lease->key);
+    if (!reply) return 0;
+
+    int valid = reply->type == REDIS_REPLY_STRING && strcmp(reply->str, value) == 0;
+    freeReplyObject(reply);
+    return valid;
+}
+
+int cluster_commit(cluster_t *cl, const cluster_lease_t *lease) {
+    char value[192];
+    cluster_lease_value(cl, lease, value, sizeof(value));
+    set_renewal(cl, NULL);
+
+    redisReply *reply = redisCommand(cl->redis, "EVAL %s 1 %s %s %lld",
+                                     LUA_COMMIT, lease->key, value, CLUSTER_LEASE_MS);
+    if (!reply) return -1;
+
+    int ok = reply->type == REDIS_REPLY_INTEGER && reply->integer == 1;
+    freeReplyObject(reply);
+    if (!ok) {
+        fprintf(stderr, "[-] Cluster: lease %s lost (token %lld)\n", lease->key, lease->token);
+        return -1;
+    }
+    return 0;
+}
+
+void cluster_release(cluster_t *cl, const cluster_lease_t *lease) {
+    char value[192];
+    cluster_lease_value(cl, lease, value, sizeof(value));
+    set_renewal(cl, NULL);
+
+    redisReply *reply = redisCommand(cl->redis, "EVAL %s 1 %s %s",
+                                     LUA_RELEASE, lease->key, value);
+    if (reply) freeReplyObject(reply);
+}
+
+void cluster_probe_item(size_t shard, char *buf, size_t len) {
+    snprintf(buf, len, "probe:%zu", shard);
+}
+
+size_t cluster_probe_shard(const char *ip, int port) {
+    char item[64];
+    snprintf(item, sizeof(item), "%s:%d", ip, port);
+    return (size_t)(hrw_weight("probe", item) % CLUSTER_PROBE_SHARDS);
+}
+
+int cluster_probe_publish(cluster_t *cl, const cluster_lease_t *lease, size_t shard,
+                          const char **fields, const char **values, size_t n) {
+    if (n == 0) return 1;
+
+    char value[192], key[64], ttl[32];
+    cluster_lease_value(cl, lease, value, sizeof(value));
+    snprintf(key, sizeof(key), CLUSTER_PROBE_PREFIX "%zu", shard);
+    snprintf(ttl, sizeof(ttl), "%lld", CLUSTER_LEASE_MS * 2);
+
+    // EVAL script 2 lease shard value ttl f1 v1 ... — аргументов переменное число
+    size_t argc = 7 + 2 * n;
+    const char **argv = malloc(argc * sizeof(char *));
+    if (!argv) return -1;
+
+    argv[0] = "EVAL";
+    argv[1] = LUA_PUBLISH;
+    argv[2] = "2";
+    argv[3] = lease->key;
+    argv[4] = key;
+    argv[5] = value;
+    argv[6] = ttl;
+    for (size_t i = 0; i < n; i++) {
+        argv[7 + 2 * i] = fields[i];
+        argv[8 + 2 * i] = values[i];
+    }
+
+    redisReply *reply = redisCommandArgv(cl->redis, (int)argc, argv, NULL);
+    free(argv);
+    if (!reply) return -1;
+
+    int rc = -1;
+    if (reply->type == REDIS_REPLY_INTEGER) {
+        rc = reply->integer == 1;
+    } else if (reply->type == REDIS_REPLY_ERROR) {
+        fprintf(stderr, "[-] Redis error: %s\n", reply->str);
+    }
+    freeReplyObject(reply);
+    return rc;
+}
+
+int cluster_probe_load(cluster_t *cl, size_t shard, cluster_entry_fn fn, void *arg) {
+    redisReply *reply = redisCommand(cl->redis, "HGETALL " CLUSTER_PROBE_PREFIX "%zu", shard);
+    if (!reply) return -1;
+
+    int count = -1;
+    if (reply->type == REDIS_REPLY_ARRAY) {
+        count = 0;
+        for (size_t i = 0; i + 1 < reply->elements; i += 2) {
+            fn(reply->element[i]->str, reply->element[i + 1]->str, arg);
+            count++;
+        }
+    } else if (reply->type == REDIS_REPLY_ERROR) {
+        fprintf(stderr, "[-] Redis error: %s\n", reply->str);
+    }
+    freeReplyObject(reply);
+    return count;
+}
+
+void cluster_shutdown(cluster_t *cl) {
+    // Сначала гасим поток, иначе он вернёт узел в ZSET уже после ZREM
+    if (cl->keepalive_running) {
+        pthread_mutex_lock(&cl->keepalive_mutex);
+        cl->keepalive_stop = 1;
+        pthread_cond_signal(&cl->keepalive_cond);
+        pthread_mutex_unlock(&cl->keepalive_mutex);
+        pthread_join(cl->keepalive, NULL);
+        pthread_mutex_destroy(&cl->keepalive_mutex);
+        pthread_cond_destroy(&cl->keepalive_cond);
+        cl->keepalive_running = 0;
+    }
+
+    if (cl->redis) {
+        // Уходим явно — остальные узлы перераспределят работу сразу, не дожидаясь TTL
+        redisReply *reply = redisCommand(cl->redis, "ZREM %s %s", CLUSTER_NODES_KEY, cl->node_id);
+        if (reply) freeReplyObject(reply);
+        redisFree(cl->redis);
+        cl->redis = NULL;
+    }
+    free_members(cl);
+}
@@ -0,0 +1,148 @@
+// source/daemon/cluster/cluster.h
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <hiredis/hiredis.h>
+
+/**
+ * @brief Кластерный режим: несколько демонов делят работу через Redis.
+ *
+ * Включается переменной окружения VPN_CLUSTER=1. Каждый узел:
+ *  - раз в тик обновляет heartbeat в ZSET vpn:cluster:nodes (score = срок жизни, мс);
+ *  - выкидывает из ZSET узлы с истёкшим heartbeat (так мёртвые узлы уходят из расчёта);
+ *  - по rendezvous-хешу (HRW) выбирает «свои» элементы работы среди живых узлов;
+ *  - захватывает элемент через SET NX PX с fencing-токеном (INCR vpn:cluster:fence).
+ *
+ * Пока элемент в работе, аренда короткая (CLUSTER_WORK_MS). После успешного
+ * выполнения аренда продлевается до CLUSTER_LEASE_MS — до следующего цикла
+ * элемент никто не трогает. Если узел умер посреди работы, короткая аренда
+ * истекает, узел выпадает из ZSET, и элемент забирает новый владелец по HRW.
+ *
+ * Heartbeat продлевает отдельный поток со своим подключением к Redis каждые
+ * CLUSTER_KEEPALIVE_SEC — узел не выпадает из ZSET, пока основной поток
+ * ждёт долгую загрузку (backoff регулятора). Тот же поток продлевает и аренду
+ * элемента в работе до CLUSTER_WORK_MS, так что долгий сайт её не теряет.
+ *
+ * Перед записью результатов вызывающий проверяет аренду (cluster_lease_valid):
+ * если она истекла и элемент забрал другой узел, результаты отбрасываются.
+ *
+ * Проверка доступности серверов разбита на CLUSTER_PROBE_SHARDS шардов по ip:port.
+ * Владелец сайта публикует строки таблицы в хеш шарда vpn:cluster:probe:<n>,
+ * а проверяет и сохраняет их HRW-владелец элемента probe:<n> — соединения
+ * расходятся по всем узлам, а не только по владельцам сайтов.
+ *
+ * Проверка локально: redis-server и несколько процессов с VPN_CLUSTER=1.
+ */
+
+typedef struct {
+    redisContext *redis;
+    char node_id[128];      // host:pid — уникально и для нескольких процессов на одном хосте
+    char **members;         // живые узлы (по последнему heartbeat)
+    size_t member_count;
+
+    pthread_t keepalive;    // фоновое продление heartbeat
+    pthread_mutex_t keepalive_mutex;
+    pthread_cond_t keepalive_cond;
+    int keepalive_stop;
+    int keepalive_running;
+
+    // Аренда в работе (между claim и commit/release) — её продлевает поток heartbeat
+    char renew_key[256];
+    char renew_value[192];
+} cluster_t;
+
+/**
+ * @brief Элемент работы, захваченный этим узлом.
+ */
+typedef struct {
+    char key[256];          // vpn:cluster:lease:<item>
+    long long token;        // fencing-токен, монотонно растёт по всему кластеру
+} cluster_lease_t;
+
+/**
+ * @brief Проверяет, включён ли кластерный режим (VPN_CLUSTER=1).
+ */
+int cluster_enabled(void);
+
+/**
+ * @brief Подключается к Redis, регистрирует узел и запускает поток heartbeat.
+ * @return 0 при успехе, -1 при ошибке
+ */
+int cluster_init(cluster_t *cl);
+
+/**
+ * @brief Обновляет heartbeat, чистит мёртвые узлы и перечитывает список живых.
+ * @return 0 при успехе, -1 при ошибке
+ */
+int cluster_heartbeat(cluster_t *cl);
+
+/**
+ * @brief Является ли этот узел HRW-владельцем элемента среди живых узлов.
+ */
+int cluster_is_owner(const cluster_t *cl, const char *item);
+
+/**
+ * @brief Пытается захватить элемент (SET NX PX CLUSTER_WORK_MS).
+ * @return 1 — захвачен, 0 — занят другим узлом, -1 — ошибка Redis
+ */
+int cluster_claim(cluster_t *cl, const char *item, cluster_lease_t *lease);
+
+/**
+ * @brief Проверяет, что аренда всё ещё наша (токен не перехвачен).
+ * @return 1 — аренда действительна, 0 — потеряна
+ */
+int cluster_lease_valid(cluster_t *cl, const cluster_lease_t *lease);
+
+/**
+ * @brief Значение аренды в Redis (node_id:token) — для записей под арендой.
+ */
+void cluster_lease_value(const cluster_t *cl, const cluster_lease_t *lease, char *buf, size_t len);
+
+/**
+ * @brief Фиксирует выполненную работу: продлевает аренду до CLUSTER_LEASE_MS.
+ * @return 0 при успехе, -1 если аренда уже потеряна
+ */
+int cluster_commit(cluster_t *cl, const cluster_lease_t *lease);
+
+/**
+ * @brief Снимает аренду без фиксации (работа не удалась — пусть повторят).
+ */
+void cluster_release(cluster_t *cl, const cluster_lease_t *lease);
+
+/**
+ * @brief Имя элемента работы для шарда проверки доступности серверов.
+ */
+void cluster_probe_item(size_t shard, char *buf, size_t len);
+
+/**
+ * @brief Номер шарда проверки для сервера (по ip:port).
+ */
+size_t cluster_probe_shard(const char *ip, int port);
+
+/**
+ * @brief Публикует кандидатов на проверку в хеш шарда, только пока аренда наша.
+ *
+ * Хеш живёт два цикла (2 * CLUSTER_LEASE_MS): серверы, пропавшие со страницы, уходят сами.
+ *
+ * @param lease — аренда элемента, от имени которого пишем (сайт)
+ * @return 1 — записано, 0 — аренда потеряна, -1 — ошибка Redis
+ */
+int cluster_probe_publish(cluster_t *cl, const cluster_lease_t *lease, size_t shard,
+                          const char **fields, const char **values, size_t n);
+
+typedef void (*cluster_entry_fn)(const char *field, const char *value, void *arg);
+
+/**
+ * @brief Читает всех кандидатов шарда.
+ * @return число записей или -1 при ошибке Redis
+ */
+int cluster_probe_load(cluster_t *cl, size_t shard, cluster_entry_fn fn, void *arg);
+
+/**
+ * @brief Останавливает поток heartbeat, удаляет узел из кластера и закрывает подключение.
+ */
+void cluster_shutdown(cluster_t *cl);
+
+#endif
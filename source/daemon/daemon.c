@@ -11,37 +11,18 @@
 #include <sys/types.h>
 #include <time.h>
 #include <limits.h>
+#include <arpa/inet.h>
 
 #include "parser/sites.h"
+#include "parser/parser.h"
+#include "cluster/cluster.h"
+#include "governor/governor.h"
+#include "io/io_batch.h"
+#include "../../config/config.h"
 #include "../../database/redis/utils/redis_store.h"
+#include "../../database/mongo/mongo_ops.h"
 
 #include <curl/curl.h>
-#include <libxml/HTMLparser.h>
-#include <libxml/xpath.h>
-
-// Буфер для ответа от сервера
-struct MemoryStruct {
-    char *memory;
-    size_t size;
-};
-
-static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp) {
-    size_t realsize = size * nmemb;  
-    struct MemoryStruct *mem = (struct MemoryStruct *)userp;
-
-    char *ptr = realloc(mem->memory, mem->size + realsize + 1);
-    if (!ptr) {
-        fprintf(stderr, "[-] realloc() failed\n");
-        return 0;
-    }
-
-    mem->memory = ptr;
-    memcpy(&(mem->memory[mem->size]), contents, realsize);
-    mem->size += realsize;
-    mem->memory[mem->size] = 0;
-
-    return realsize;
-}
 
 // Безопасное сохранение файла в разрешённую директорию
 int save_file_safe(const char *filename, const char *content, size_t len) {
@@ -94,150 +75,422 @@ int save_file_safe(const char *filename, const char *content, size_t len) {
         return -1;
     }
 
-    FILE *fp = fopen(real_target, "wb");
-    if (!fp) {
-        perror("[-] fopen");
-        return -1;
-    }
+    // С io_uring запись только ставится в очередь и уходит в io_flush() в конце цикла
+    return io_save_file(real_target, content, len);
+}
 
-    fwrite(content, 1, len, fp);
-    fclose(fp);
-    printf("[+] Saved: %s\n", real_target);
+// Подключение к Redis для таблиц серверов; переподключаемся в начале цикла
+static redisContext *store;
+
+// Аренда элемента, который сейчас обрабатываем в кластерном режиме (NULL — без кластера)
+static cluster_t *fence_cluster;
+static const cluster_lease_t *fence_lease;
+
+// Можно ли писать результаты: пока мы качали, аренда могла истечь и уйти другому узлу
+static int lease_held(void) {
+    if (!fence_cluster) return 1;
+    if (cluster_lease_valid(fence_cluster, fence_lease)) return 1;
+
+    fprintf(stderr, "[-] Cluster: lease %s lost (token %lld), dropping results\n",
+            fence_lease->key, fence_lease->token);
     return 0;
 }
 
-// Парсим HTML и ищем .ovpn ссылки
-void parse_html_for_ovpn(const char *html_content, const char *site_name) {
-    htmlDocPtr doc = htmlReadDoc((xmlChar*)html_content, NULL, NULL,
-                                 HTML_PARSE_RECOVER | HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
-    if (!doc) {
-        fprintf(stderr, "[-] Failed to parse HTML from %s\n", site_name);
+// Скачанный .ovpn сохраняем под именем из URL
+static void on_ovpn_downloaded(const char *url, const char *body, size_t len, long status, void *arg) {
+    (void)arg;
+    if (!body || status < 200 || status >= 300) {
+        fprintf(stderr, "[-] Download failed: %s (HTTP %ld)\n", url, status);
         return;
     }
 
-    xmlXPathContextPtr xpathCtx = xmlXPathNewContext(doc);
-    xmlXPathObjectPtr xpathObj = xmlXPathEvalExpression(
-        (xmlChar*)"//a[@href and contains(@href, '.ovpn')]", xpathCtx);
-
-    if (xpathObj && xpathObj->nodesetval && xpathObj->nodesetval->nodeNr > 0) {
-        for (int i = 0; i < xpathObj->nodesetval->nodeNr; i++) {
-            xmlNodePtr node = xpathObj->nodesetval->nodeTab[i];
-            xmlChar *href = xmlGetProp(node, (xmlChar*)"href");
-
-            if (href) {
-                char full_url[2048];
-                if (strncmp((char*)href, "http", 4) == 0) {
-                    // Абсолютная ссылка
-                    strncpy(full_url, (char*)href, sizeof(full_url) - 1);
-                    full_url[sizeof(full_url) - 1] = '\0';
-                } else {
-                    // Относительная ссылка
-                    if (strcmp(site_name, "vpngate") == 0) {
-                        snprintf(full_url, sizeof(full_url), "https://www.vpngate.net%s", href);
-                    } else if (strcmp(site_name, "vpnbook") == 0) {
-                        snprintf(full_url, sizeof(full_url), "https://www.vpnbook.com%s", href);
-                    } else {
-                        snprintf(full_url, sizeof(full_url), "https://%s%s", site_name, href);
-                    }
-                }
-
-                printf("[*] Found OVPN: %s\n", full_url);
-
-                // Скачиваем сам файл
-                CURL *curl;
-                CURLcode res;
-                struct MemoryStruct chunk = {0};
-
-                chunk.memory = malloc(1);
-                if (!chunk.memory) {
-                    xmlFree(href);
-                    continue;
-                }
-
-                curl = curl_easy_init();
-                if (curl) {
-                    curl_easy_setopt(curl, CURLOPT_URL, full_url);
-                    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
-                    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&chunk);
-                    curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0 (compatible; VPNParser/1.0)");
-                    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-                    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-
-                    res = curl_easy_perform(curl);
-                    if (res == CURLE_OK) {
-                        // Извлекаем имя файла из URL
-                        char *last_slash = strrchr(full_url, '/');
-                        const char *fname = last_slash ? last_slash + 1 : "config.ovpn";
-                        save_file_safe(fname, chunk.memory, chunk.size);
-                    } else {
-                        fprintf(stderr, "[-] Download failed: %s\n", curl_easy_strerror(res));
-                    }
-
-                    curl_easy_cleanup(curl);
-                }
-                free(chunk.memory);
-                xmlFree(href);
-            }
+    const char *last_slash = strrchr(url, '/');
+    const char *fname = last_slash ? last_slash + 1 : "config.ovpn";
+    if (!lease_held()) return;
+    save_file_safe(fname, body, len);
+}
+
+static void on_ovpn_link(const char *url, void *arg) {
+    (void)arg;
+    printf("[*] Found OVPN: %s\n", url);
+
+    // Скачиваем сам файл — через регулятор, с учётом лимитов хоста
+    governor_submit(url, on_ovpn_downloaded, NULL);
+}
+
+static int is_valid_ip(const char *ip) {
+    struct in_addr addr;
+
+    return inet_aton(ip, &addr) != 0;
+}
+
+// Строки таблицы живут только внутри обработчика — копируем до проверки доступности
+struct server_row {
+    char ip[46];
+    char protocol[8];
+    char country[48];
+    char config_url[512];
+    const char *source;     // имя сайта из SUPPORTED_SITES — статическое
+    int port;
+    double score;
+};
+
+// Строки одного сайта или одного шарда проверки в кластере
+struct server_rows {
+    struct server_row *rows;
+    size_t count;
+    size_t cap;
+};
+
+static struct server_row *rows_add(struct server_rows *rows) {
+    if (rows->count == rows->cap) {
+        size_t cap = rows->cap ? rows->cap * 2 : 16;
+        struct server_row *grown = realloc(rows->rows, cap * sizeof(struct server_row));
+        if (!grown) return NULL;
+        rows->rows = grown;
+        rows->cap = cap;
+    }
+    struct server_row *r = &rows->rows[rows->count++];
+    memset(r, 0, sizeof(*r));
+    return r;
+}
+
+static void rows_free(struct server_rows *rows) {
+    free(rows->rows);
+    memset(rows, 0, sizeof(*rows));
+}
+
+static void on_server_row(const vpn_server_t *server, void *arg) {
+    struct server_rows *rows = (struct server_rows *)arg;
+
+    if (rows->count == MAX_SERVERS_PER_SITE || !is_valid_ip(server->ip)) return;
+
+    struct server_row *r = rows_add(rows);
+    if (!r) return;
+    snprintf(r->ip, sizeof(r->ip), "%s", server->ip);
+    snprintf(r->protocol, sizeof(r->protocol), "%s", server->protocol);
+    snprintf(r->country, sizeof(r->country), "%s", server->country);
+    snprintf(r->config_url, sizeof(r->config_url), "%s", server->config_url);
+    r->source = server->source;
+    r->port = server->port;
+    r->score = server->score;
+}
+
+// Единственный путь сохранения строк таблицы серверов; -1 — аренда кластера потеряна
+static int save_server_row(const struct server_row *r) {
+    // В кластере строка пишется в Redis атомарно с проверкой аренды
+    if (fence_cluster && store) {
+        char value[192];
+        cluster_lease_value(fence_cluster, fence_lease, value, sizeof(value));
+
+        if (redis_save_vpn_server_fenced(
+                store, fence_lease->key, value, r->source,
+                r->ip, r->port, r->protocol,
+                r->country, r->score, r->config_url) == 0) {
+            fprintf(stderr, "[-] Cluster: lease %s lost (token %lld), dropping results\n",
+                    fence_lease->key, fence_lease->token);
+            return -1;
         }
     }
 
-    xmlXPathFreeObject(xpathObj);
-    xmlXPathFreeContext(xpathCtx);
-    xmlFreeDoc(doc);
+    // История — в фоновую очередь архива, запись в MongoDB не ждём
+    mongo_archive_record(r->source, r->ip, r->port, r->protocol, r->country, r->score);
+
+    if (!store || fence_cluster) return 0;
+
+    redis_save_vpn_server(
+        store, r->source,
+        r->ip, r->port, r->protocol,
+        r->country, r->score, r->config_url
+    );
+    return 0;
+}
+
+// Состояние загрузки страницы одного сайта
+struct site_fetch {
+    size_t site;                // индекс в SUPPORTED_SITES
+    int rc;
+    struct server_rows rows;    // строки таблицы — проверяем после governor_run()
+};
+
+// Парсим HTML по записи сайта в реестре: ссылки на .ovpn и таблица серверов.
+// Строки только собираем: connect внутри обработчика curl задержал бы остальные хосты
+void parse_html_for_ovpn(const char *html_content, struct site_fetch *sf) {
+    site_sink_t sink = { on_ovpn_link, on_server_row, &sf->rows };
+    extract_site(sf->site, html_content, &sink);
 }
 
-// Функция для парсинга одного сайта
-int fetch_site(const char *url, const char *site_name) {
-    CURL *curl;
-    CURLcode res;
-    struct MemoryStruct chunk = {0};
-
-    chunk.memory = malloc(1);
-    if (!chunk.memory) return -1;
-
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&chunk);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0 (compatible; VPNParser/1.0)");
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-
-        res = curl_easy_perform(curl);
-        if (res == CURLE_OK) {
-            printf("[+] Fetched %s successfully.\n", url);
-            parse_html_for_ovpn(chunk.memory, site_name);
-        } else {
-            fprintf(stderr, "[-] Failed to fetch %s: %s\n", url, curl_easy_strerror(res));
+// Доступность проверяем пачкой: все connect разом, а не по одному с таймаутом.
+// -1 — аренда потеряна, сохранено не всё
+static int probe_and_save_rows(const char *what, const struct server_rows *rows) {
+    if (rows->count == 0) return 0;
+
+    io_probe_t *targets = calloc(rows->count, sizeof(io_probe_t));
+    int *reachable = calloc(rows->count, sizeof(int));
+    if (!targets || !reachable) {
+        free(targets);
+        free(reachable);
+        return 0;
+    }
+
+    for (size_t i = 0; i < rows->count; i++) {
+        targets[i].ip = rows->rows[i].ip;
+        targets[i].port = rows->rows[i].port;
+    }
+    size_t alive = io_probe_batch(targets, rows->count, reachable);
+
+    int rc = -1;
+    if (lease_held()) {
+        size_t i = 0;
+        while (i < rows->count && (!reachable[i] || save_server_row(&rows->rows[i]) == 0)) i++;
+        if (i == rows->count) {
+            printf("[+] %s: %zu of %zu servers reachable, saved\n", what, alive, rows->count);
+            rc = 0;
         }
+    }
+    free(targets);
+    free(reachable);
+    return rc;
+}
+
+// Кандидат в хеше шарда: поле "сайт<TAB>ip<TAB>порт",
+// значение "протокол<TAB>рейтинг<TAB>url<TAB>страна" — страна последней, она из HTML
+static void format_candidate(const struct server_row *r, char *field, size_t flen,
+                             char *value, size_t vlen) {
+    snprintf(field, flen, "%s\t%s\t%d", r->source, r->ip, r->port);
+    snprintf(value, vlen, "%s\t%f\t%s\t%s", r->protocol, r->score, r->config_url, r->country);
+}
+
+static void on_candidate(const char *field, const char *value, void *arg) {
+    struct server_rows *rows = (struct server_rows *)arg;
+    struct server_row r;
+    char source[64];
 
-        curl_easy_cleanup(curl);
+    memset(&r, 0, sizeof(r));
+    if (sscanf(field, "%63[^\t]\t%45[^\t]\t%d", source, r.ip, &r.port) != 3) return;
+    if (sscanf(value, "%7[^\t]\t%lf\t%511[^\t]\t%47[^\n]",
+               r.protocol, &r.score, r.config_url, r.country) < 3) return;
+    if (!is_valid_ip(r.ip)) return;
+
+    // Имя сайта берём из реестра: в строке хранится указатель на статическую строку
+    for (size_t i = 0; i < SITE_COUNT; i++) {
+        if (strcmp(SUPPORTED_SITES[i].name, source) == 0) r.source = SUPPORTED_SITES[i].name;
     }
+    if (!r.source) return;
 
-    free(chunk.memory);
-    return 0;
+    struct server_row *slot = rows_add(rows);
+    if (slot) *slot = r;
+}
+
+// Кластер: строки сайта не проверяем сами, а раскладываем по шардам проверки
+static int publish_rows(cluster_t *cl, const cluster_lease_t *lease, const struct server_rows *rows) {
+    size_t n = rows->count;
+    if (n == 0) return 0;
+
+    char (*fields)[128] = calloc(n, sizeof(*fields));
+    char (*values)[640] = calloc(n, sizeof(*values));
+    const char **fptr = calloc(n, sizeof(char *));
+    const char **vptr = calloc(n, sizeof(char *));
+    size_t *shard = calloc(n, sizeof(size_t));
+    int rc = -1;
+
+    if (fields && values && fptr && vptr && shard) {
+        for (size_t i = 0; i < n; i++) {
+            format_candidate(&rows->rows[i], fields[i], sizeof(fields[i]), values[i], sizeof(values[i]));
+            shard[i] = cluster_probe_shard(rows->rows[i].ip, rows->rows[i].port);
+        }
+
+        rc = 0;
+        for (size_t s = 0; s < CLUSTER_PROBE_SHARDS && rc == 0; s++) {
+            size_t k = 0;
+            for (size_t i = 0; i < n; i++) {
+                if (shard[i] != s) continue;
+                fptr[k] = fields[i];
+                vptr[k] = values[i];
+                k++;
+            }
+            if (cluster_probe_publish(cl, lease, s, fptr, vptr, k) != 1) rc = -1;
+        }
+    }
+
+    if (rc != 0) {
+        fprintf(stderr, "[-] Cluster: publishing %zu servers under %s failed\n", n, lease->key);
+    }
+    free(fields);
+    free(values);
+    free(fptr);
+    free(vptr);
+    free(shard);
+    return rc;
+}
+
+static void on_site_fetched(const char *url, const char *body, size_t len, long status, void *arg) {
+    (void)len;
+    struct site_fetch *sf = (struct site_fetch *)arg;
+
+    if (!body || status < 200 || status >= 300) {
+        fprintf(stderr, "[-] Failed to fetch %s (HTTP %ld)\n", url, status);
+        return;
+    }
+
+    printf("[+] Fetched %s successfully.\n", url);
+    parse_html_for_ovpn(body, sf);
+    sf->rc = 0;
+}
+
+static void store_reconnect(void) {
+    if (store && store->err) {
+        redisFree(store);
+        store = NULL;
+    }
+    if (!store) store = redis_connect();
+
+    // Не блокируется: к MongoDB подключается и переподключается фоновый поток архива
+    mongo_archive_start(MONGO_URI);
+}
+
+// Функция для парсинга одного сайта в кластерном режиме: пишем, только пока аренда наша
+int fetch_site(size_t site, cluster_t *cl, const cluster_lease_t *lease) {
+    struct site_fetch sf = { site, -1, { NULL, 0, 0 } };
+
+    store_reconnect();
+    if (governor_submit(SUPPORTED_SITES[site].url, on_site_fetched, &sf) != 0) return -1;
+
+    fence_cluster = cl;
+    fence_lease = lease;
+    governor_run();
+
+    // Проверяет строки владелец шарда (probe_shard), возможно, другой узел
+    if (sf.rc == 0 && publish_rows(cl, lease, &sf.rows) != 0) sf.rc = -1;
+    rows_free(&sf.rows);
+
+    // Отложенные сохранения io_uring уходят на диск только здесь — проверяем аренду ещё раз
+    if (lease_held()) {
+        io_flush();
+    } else {
+        io_discard();
+        sf.rc = -1;
+    }
+    fence_cluster = NULL;
+    fence_lease = NULL;
+
+    mongo_archive_flush();
+    return sf.rc;
+}
+
+// Шард проверки в кластерном режиме: кандидатов опубликовали владельцы сайтов
+static int probe_shard(size_t shard, cluster_t *cl, const cluster_lease_t *lease) {
+    struct server_rows rows = { NULL, 0, 0 };
+
+    store_reconnect();
+    // Пустой шард не фиксируем: владелец сайта мог ещё не опубликовать строки — повторим в следующий тик
+    if (cluster_probe_load(cl, shard, on_candidate, &rows) <= 0 || rows.count == 0) {
+        rows_free(&rows);
+        return -1;
+    }
+
+    char what[32];
+    snprintf(what, sizeof(what), "probe shard %zu", shard);
+
+    fence_cluster = cl;
+    fence_lease = lease;
+    int rc = probe_and_save_rows(what, &rows);
+    fence_cluster = NULL;
+    fence_lease = NULL;
+
+    rows_free(&rows);
+    mongo_archive_flush();
+    return rc;
 }
 
 // Главная функция парсинга сайтов
 int fetch_and_parse_vpn_sites(void) {
     printf("[*] Starting VPN config parser...\n");
 
-    struct {
-        const char *url;
-        const char *name;
-    } sites[] = {
-        {"https://www.vpngate.net/en/", "vpngate"},
-        {"https://www.vpnbook.com/freevpn", "vpnbook"},
-    };
+    store_reconnect();
+
+    // Все сайты ставим в очередь разом: регулятор качает их параллельно,
+    // соблюдая лимиты каждого хоста
+    struct site_fetch sf[SITE_COUNT];
+    for (size_t i = 0; i < SITE_COUNT; i++) {
+        sf[i].site = i;
+        sf[i].rc = -1;
+        memset(&sf[i].rows, 0, sizeof(sf[i].rows));
+        governor_submit(SUPPORTED_SITES[i].url, on_site_fetched, &sf[i]);
+    }
+    governor_run();
 
-    for (size_t i = 0; i < sizeof(sites)/sizeof(sites[0]); i++) {
-        fetch_site(sites[i].url, sites[i].name);
+    // Проверка доступности — после загрузок, но до io_flush()
+    for (size_t i = 0; i < SITE_COUNT; i++) {
+        probe_and_save_rows(SUPPORTED_SITES[i].name, &sf[i].rows);
+        rows_free(&sf[i].rows);
     }
+    io_flush();
+    mongo_archive_flush();
+    fflush(stdout);
+    fflush(stderr);
 
     return 0;
 }
 
+// Кластерный цикл: берём только те сайты, чьи аренды достались нам
+static void run_cluster_loop(void) {
+    cluster_t cl;
+
+    while (cluster_init(&cl) != 0) {
+        fprintf(stderr, "[-] Cluster init failed, retrying in %d s\n", CLUSTER_TICK);
+        sleep(CLUSTER_TICK);
+    }
+
+    while (1) {
+        if (cluster_heartbeat(&cl) != 0) {
+            // Соединение с Redis потеряно — переподключаемся
+            cluster_shutdown(&cl);
+            while (cluster_init(&cl) != 0) sleep(CLUSTER_TICK);
+        }
+
+        for (size_t i = 0; i < SITE_COUNT; i++) {
+            char item[128];
+            snprintf(item, sizeof(item), "site:%s", SUPPORTED_SITES[i].name);
+
+            if (!cluster_is_owner(&cl, item)) continue;
+
+            cluster_lease_t lease;
+            if (cluster_claim(&cl, item, &lease) != 1) continue;
+
+            time_t now = time(NULL);
+            printf("[*] Cluster: %s claimed (token %lld) at %s", item, lease.token, ctime(&now));
+
+            if (fetch_site(i, &cl, &lease) == 0) {
+                cluster_commit(&cl, &lease);
+            } else {
+                cluster_release(&cl, &lease);
+            }
+        }
+
+        // Проверка доступности — по шардам ip:port, каждый у своего HRW-владельца
+        for (size_t shard = 0; shard < CLUSTER_PROBE_SHARDS; shard++) {
+            char item[128];
+            cluster_probe_item(shard, item, sizeof(item));
+
+            if (!cluster_is_owner(&cl, item)) continue;
+
+            cluster_lease_t lease;
+            if (cluster_claim(&cl, item, &lease) != 1) continue;
+
+            if (probe_shard(shard, &cl, &lease) == 0) {
+                cluster_commit(&cl, &lease);
+            } else {
+                cluster_release(&cl, &lease);
+            }
+        }
+
+        fflush(stdout);
+        fflush(stderr);
+        sleep(CLUSTER_TICK);
+    }
+}
+
 // Запуск демона (фоновый режим)
 int start_daemon(void) {
     pid_t pid = fork();
@@ -271,6 +524,26 @@ int start_daemon(void) {
         close(logfd);
     }
 
+    // Лог пишется блоками, а не строкой на write(); сбрасываем в конце каждого цикла
+    setvbuf(stdout, NULL, _IOFBF, 65536);
+    setvbuf(stderr, NULL, _IOFBF, 65536);
+
+    // VPN_IO=blocking — принудительно прежний путь без io_uring
+    const char *io_mode = getenv("VPN_IO");
+    io_batch_init(!(io_mode && strcmp(io_mode, "blocking") == 0));
+    printf("[*] I/O backend: %s\n", io_batch_backend());
+
+    // XPath всех сайтов компилируется один раз
+    if (extractor_init() != 0) {
+        fprintf(stderr, "[-] Site registry init failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (cluster_enabled()) {
+        run_cluster_loop();
+        return 0;
+    }
+
     // Основной цикл
     while (1) {
         time_t now = time(NULL);
@@ -0,0 +1,325 @@
+// source/daemon/governor/governor.c
+#define _POSIX_C_SOURCE 200809L
+
+#include "governor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include <curl/curl.h>
+
+#include "../../../config/config.h"
+
+#define GOV_MAX_HOSTS 32
+
+typedef struct gov_request {
+    char *url;
+    gov_done_fn cb;
+    void *arg;
+    int retries;
+
+    char *body;
+    size_t len;
+
+    struct gov_host *host;
+    struct gov_request *next;
+} gov_request_t;
+
+typedef struct gov_host {
+    char name[256];
+
+    double tokens;
+    double rate;            // текущая скорость (адаптивная), запросов/с
+    double last_refill;     // монотонные секунды
+
+    int inflight;
+    double blocked_until;   // откат после 429/503
+    int backoff_exp;
+
+    gov_request_t *head;
+    gov_request_t *tail;
+} gov_host_t;
+
+static CURLM *multi;
+static gov_host_t hosts[GOV_MAX_HOSTS];
+static size_t host_count;
+static size_t rr_next;      // с какого хоста начинать следующий проход
+static size_t queued;
+static size_t running;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t body_callback(void *contents, size_t size, size_t nmemb, void *userp) {
+    size_t realsize = size * nmemb;
+    gov_request_t *req = (gov_request_t *)userp;
+
+    char *ptr = realloc(req->body, req->len + realsize + 1);
+    if (!ptr) {
+        fprintf(stderr, "[-] realloc() failed\n");
+        return 0;
+    }
+
+    req->body = ptr;
+    memcpy(req->body + req->len, contents, realsize);
+    req->len += realsize;
+    req->body[req->len] = 0;
+    return realsize;
+}
+
+// Хост из URL: между "://" и первым '/', ':' или '?'
+static gov_host_t *host_for(const char *url) {
+    const char *p = strstr(url, "://");
+    p = p ? p + 3 : url;
+    size_t n = strcspn(p, "/:?#");
+
+    char name[256];
+    if (n >= sizeof(name)) n = sizeof(name) - 1;
+    memcpy(name, p, n);
+    name[n] = '\0';
+
+    for (size_t i = 0; i < host_count; i++) {
+        if (strcasecmp(hosts[i].name, name) == 0) return &hosts[i];
+    }
+    if (host_count == GOV_MAX_HOSTS) {
+        fprintf(stderr, "[-] Governor: too many hosts, %s rejected\n", name);
+        return NULL;
+    }
+
+    gov_host_t *h = &hosts[host_count++];
+    memset(h, 0, sizeof(*h));
+    strcpy(h->name, name);
+    h->tokens = GOV_BURST;
+    h->rate = GOV_RATE;
+    h->last_refill = now_sec();
+    return h;
+}
+
+static void refill(gov_host_t *h, double now) {
+    h->tokens += (now - h->last_refill) * h->rate;
+    if (h->tokens > GOV_BURST) h->tokens = GOV_BURST;
+    h->last_refill = now;
+}
+
+static void enqueue(gov_host_t *h, gov_request_t *req, int front) {
+    if (front) {
+        req->next = h->head;
+        h->head = req;
+        if (!h->tail) h->tail = req;
+    } else {
+        req->next = NULL;
+        if (h->tail) h->tail->next = req;
+        else h->head = req;
+        h->tail = req;
+    }
+    queued++;
+}
+
+static void request_free(gov_request_t *req) {
+    free(req->url);
+    free(req->body);
+    free(req);
+}
+
+static int start_request(gov_request_t *req) {
+    CURL *curl = curl_easy_init();
+    if (!curl) return -1;
+
+    curl_easy_setopt(curl, CURLOPT_URL, req->url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, body_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)req);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, (void *)req);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0 (compatible; VPNParser/1.0)");
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)HTTP_TIMEOUT);
+
+    if (curl_multi_add_handle(multi, curl) != CURLM_OK) {
+        curl_easy_cleanup(curl);
+        return -1;
+    }
+    return 0;
+}
+
+// Пускает новые запросы: по одному на хост за проход, начиная с rr_next
+static void dispatch(double now) {
+    int started = 1;
+    while (started) {
+        started = 0;
+        for (size_t k = 0; k < host_count; k++) {
+            size_t i = (rr_next + k) % host_count;
+            gov_host_t *h = &hosts[i];
+
+            if (!h->head || h->inflight >= GOV_MAX_INFLIGHT || now < h->blocked_until) continue;
+            refill(h, now);
+            if (h->tokens < 1.0) continue;
+
+            gov_request_t *req = h->head;
+            h->head = req->next;
+            if (!h->head) h->tail = NULL;
+            queued--;
+
+            if (start_request(req) != 0) {
+                fprintf(stderr, "[-] Governor: cannot start %s\n", req->url);
+                req->cb(req->url, NULL, 0, 0, req->arg);
+                request_free(req);
+                continue;
+            }
+
+            h->tokens -= 1.0;
+            h->inflight++;
+            running++;
+            started = 1;
+            rr_next = (i + 1) % host_count;
+        }
+    }
+}
+
+// Сколько ждать до момента, когда какой-то хост сможет стартовать (мс)
+static int next_wakeup_ms(double now) {
+    double wait = 1.0;
+    for (size_t i = 0; i < host_count; i++) {
+        gov_host_t *h = &hosts[i];
+        if (!h->head || h->inflight >= GOV_MAX_INFLIGHT) continue;
+
+        double t = 0.0;
+        if (now < h->blocked_until) t = h->blocked_until - now;
+        else if (h->tokens < 1.0) t = (1.0 - h->tokens) / h->rate;
+        if (t < wait) wait = t;
+    }
+    int ms = (int)(wait * 1000.0) + 1;
+    return ms < 1 ? 1 : ms;
+}
+
+static void on_finished(CURL *curl, CURLcode result) {
+    gov_request_t *req = NULL;
+    long status = 0;
+    curl_off_t retry_after = 0;
+
+    curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char **)&req);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_getinfo(curl, CURLINFO_RETRY_AFTER, &retry_after);
+    curl_multi_remove_handle(multi, curl);
+    curl_easy_cleanup(curl);
+
+    gov_host_t *h = req->host;
+    h->inflight--;
+    running--;
+
+    if (result == CURLE_OK && (status == 429 || status == 503)) {
+        // Источник просит притормозить: пауза и мультипликативное снижение скорости
+        double delay = GOV_BACKOFF_BASE_MS / 1000.0 * (double)(1 << h->backoff_exp);
+        if (retry_after > 0) delay = (double)retry_after;
+        if (delay > GOV_BACKOFF_MAX_MS / 1000.0) delay = GOV_BACKOFF_MAX_MS / 1000.0;
+        if (h->backoff_exp < 16) h->backoff_exp++;
+
+        double now = now_sec();
+        if (h->blocked_until < now + delay) h->blocked_until = now + delay;
+        refill(h, now);
+        h->rate /= 2.0;
+        if (h->rate < GOV_MIN_RATE) h->rate = GOV_MIN_RATE;
+        h->tokens = 0.0;
+
+        fprintf(stderr, "[-] %s throttled (HTTP %ld), pausing %.1f s, rate %.2f/s\n",
+                h->name, status, delay, h->rate);
+
+        if (req->retries++ < GOV_MAX_RETRIES) {
+            free(req->body);
+            req->body = NULL;
+            req->len = 0;
+            enqueue(h, req, 1);
+            return;
+        }
+    } else if (result == CURLE_OK) {
+        // Аддитивное восстановление скорости
+        h->backoff_exp = 0;
+        refill(h, now_sec());
+        h->rate += GOV_RATE / 10.0;
+        if (h->rate > GOV_RATE) h->rate = GOV_RATE;
+    } else {
+        fprintf(stderr, "[-] Failed to fetch %s: %s\n", req->url, curl_easy_strerror(result));
+    }
+
+    req->cb(req->url, result == CURLE_OK ? req->body : NULL, req->len,
+            result == CURLE_OK ? status : 0, req->arg);
+    request_free(req);
+}
+
+int governor_init(void) {
+    if (multi) return 0;
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) return -1;
+
+    multi = curl_multi_init();
+    if (!multi) return -1;
+
+    // Общий пул соединений: keep-alive к одному хосту переиспользуется
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)GOV_MAX_INFLIGHT);
+    return 0;
+}
+
+int governor_submit(const char *url, gov_done_fn cb, void *arg) {
+    if (!multi && governor_init() != 0) return -1;
+
+    gov_host_t *h = host_for(url);
+    if (!h) return -1;
+
+    gov_request_t *req = calloc(1, sizeof(*req));
+    if (!req) return -1;
+    req->url = strdup(url);
+    if (!req->url) {
+        free(req);
+        return -1;
+    }
+    req->cb = cb;
+    req->arg = arg;
+    req->host = h;
+
+    enqueue(h, req, 0);
+    return 0;
+}
+
+void governor_run(void) {
+    if (!multi) return;
+
+    while (queued > 0 || running > 0) {
+        dispatch(now_sec());
+
+        int still_running = 0;
+        curl_multi_perform(multi, &still_running);
+
+        CURLMsg *msg;
+        int left;
+        while ((msg = curl_multi_info_read(multi, &left))) {
+            if (msg->msg == CURLMSG_DONE) {
+                on_finished(msg->easy_handle, msg->data.result);
+            }
+        }
+
+        if (queued > 0 || running > 0) {
+            curl_multi_poll(multi, NULL, 0, next_wakeup_ms(now_sec()), NULL);
+        }
+    }
+}
+
+void governor_cleanup(void) {
+    if (!multi) return;
+
+    for (size_t i = 0; i < host_count; i++) {
+        gov_request_t *req = hosts[i].head;
+        while (req) {
+            gov_request_t *next = req->next;
+            request_free(req);
+            req = next;
+        }
+    }
+    host_count = 0;
+    queued = 0;
+
+    curl_multi_cleanup(multi);
+    multi = NULL;
+    curl_global_cleanup();
+}
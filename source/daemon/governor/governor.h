@@ -0,0 +1,52 @@
+// source/daemon/governor/governor.h
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <stddef.h>
+
+/**
+ * @brief Регулятор исходящих HTTP-запросов по хостам.
+ *
+ * Все загрузки демона (страницы сайтов и .ovpn) идут через очередь.
+ * Для каждого хоста действуют:
+ *  - token bucket: не больше GOV_RATE запросов в секунду, всплеск до GOV_BURST;
+ *  - ограничение одновременных запросов GOV_MAX_INFLIGHT;
+ *  - адаптивный откат на 429/503: пауза по Retry-After (или экспоненциальная),
+ *    скорость падает вдвое и затем плавно восстанавливается на успешных ответах.
+ * Хосты обслуживаются по кругу, по одному запросу за проход, поэтому медленный
+ * или забаненный источник не задерживает остальные.
+ */
+
+/**
+ * @brief Обработчик завершённого запроса.
+ * @param url — URL запроса
+ * @param body — тело ответа (NULL при сетевой ошибке), освобождается после вызова
+ * @param len — длина тела
+ * @param status — HTTP-код (0 при сетевой ошибке)
+ * @param arg — пользовательский аргумент из governor_submit()
+ */
+typedef void (*gov_done_fn)(const char *url, const char *body, size_t len, long status, void *arg);
+
+/**
+ * @brief Инициализирует регулятор (curl multi).
+ * @return 0 при успехе, -1 при ошибке
+ */
+int governor_init(void);
+
+/**
+ * @brief Ставит запрос в очередь хоста. Можно вызывать из обработчика.
+ * @return 0 при успехе, -1 при ошибке
+ */
+int governor_submit(const char *url, gov_done_fn cb, void *arg);
+
+/**
+ * @brief Выполняет очередь до конца (включая запросы, добавленные по ходу).
+ */
+void governor_run(void);
+
+/**
+ * @brief Освобождает ресурсы регулятора.
+ */
+void governor_cleanup(void);
+
+#endif
@@ -0,0 +1,678 @@
+// source/daemon/io/io_batch.c
+#define _GNU_SOURCE
+
+#include "io_batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+
+#include "../../../config/config.h"
+
+// Что за операция в user_data: (индекс << 8) | вид
+enum {
+    OP_OPEN = 1,
+    OP_WRITE,
+    OP_FSYNC,
+    OP_CLOSE,
+    OP_RENAME,
+    OP_SOCKET,
+    OP_CONNECT,
+    OP_TIMEOUT,
+};
+
+#define SAVE_CHAIN_LEN 5
+#define PROBE_CHAIN_LEN 3
+
+typedef struct {
+    int fd;
+    unsigned entries;
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ptr, *cq_ptr;
+    size_t sq_len, cq_len, sqe_len;
+
+    unsigned local_tail;    // ещё не опубликованные SQE
+    unsigned queued;        // SQE в текущей отправке
+} ring_t;
+
+typedef struct {
+    char path[PATH_MAX];
+    char tmp[PATH_MAX];
+    char *data;
+    size_t len;
+    int fixed;              // данные лежат в зарегистрированном буфере
+    int result;             // первая ошибка цепочки (0 — успех)
+} pending_save_t;
+
+static ring_t ring;
+static int use_uring;
+static int initialized;
+static unsigned long syscalls;
+
+static char *arena;         // зарегистрированный буфер для write_fixed
+static size_t arena_used;
+
+static pending_save_t *pending;
+static size_t pending_count;
+
+/* ---------- кольцо ---------- */
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    syscalls++;
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr);
+}
+
+static void ring_unmap(ring_t *r) {
+    if (r->sqes) munmap(r->sqes, r->sqe_len);
+    if (r->cq_ptr && r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_len);
+    if (r->sq_ptr) munmap(r->sq_ptr, r->sq_len);
+    if (r->fd >= 0) close(r->fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+static int ring_setup(ring_t *r, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+
+    r->fd = sys_io_uring_setup(entries, &p);
+    if (r->fd < 0) return -1;
+
+    r->entries = p.sq_entries;
+    r->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if ((p.features & IORING_FEAT_SINGLE_MMAP) && r->cq_len > r->sq_len) r->sq_len = r->cq_len;
+
+    r->sq_ptr = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) {
+        r->sq_ptr = NULL;
+        ring_unmap(r);
+        return -1;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) {
+            r->cq_ptr = NULL;
+            ring_unmap(r);
+            return -1;
+        }
+    }
+
+    r->sqe_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqe_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        ring_unmap(r);
+        return -1;
+    }
+
+    char *sq = r->sq_ptr;
+    char *cq = r->cq_ptr;
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    r->local_tail = *r->sq_tail;
+    return 0;
+}
+
+static struct io_uring_sqe *ring_get_sqe(ring_t *r) {
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (r->local_tail - head >= r->entries) return NULL;
+
+    unsigned idx = r->local_tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    r->local_tail++;
+    r->queued++;
+    return sqe;
+}
+
+typedef void (*cqe_fn)(uint64_t user_data, int res, void *arg);
+
+// Одна отправка всех SQE и ожидание всех CQE (каждый SQE даёт ровно один CQE)
+static int ring_submit_and_reap(ring_t *r, cqe_fn fn, void *arg) {
+    unsigned expected = r->queued;
+    unsigned to_submit = r->queued;
+    unsigned seen = 0;
+    r->queued = 0;
+
+    __atomic_store_n(r->sq_tail, r->local_tail, __ATOMIC_RELEASE);
+
+    while (seen < expected) {
+        int ret = sys_io_uring_enter(r->fd, to_submit, expected - seen, IORING_ENTER_GETEVENTS);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        to_submit -= (unsigned)ret < to_submit ? (unsigned)ret : to_submit;
+
+        unsigned head = *r->cq_head;
+        unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+            fn(cqe->user_data, cqe->res, arg);
+            seen++;
+        }
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+// Все нужные операции есть начиная с 5.19; SOCKET — самая новая из них
+static int ring_supports_ops(ring_t *r) {
+    size_t len = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, len);
+    if (!probe) return 0;
+
+    int ok = 0;
+    if (sys_io_uring_register(r->fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+        static const int needed[] = {
+            IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_WRITE_FIXED, IORING_OP_FSYNC,
+            IORING_OP_CLOSE, IORING_OP_RENAMEAT, IORING_OP_SOCKET, IORING_OP_CONNECT,
+            IORING_OP_LINK_TIMEOUT,
+        };
+        ok = 1;
+        for (size_t i = 0; i < sizeof(needed) / sizeof(needed[0]); i++) {
+            if (needed[i] > probe->last_op || !(probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED)) {
+                ok = 0;
+            }
+        }
+    }
+    free(probe);
+    return ok;
+}
+
+/* ---------- блокирующий путь ---------- */
+
+static int save_blocking(const char *path, const char *tmp, const char *data, size_t len) {
+    syscalls++;
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -errno;
+
+    size_t off = 0;
+    while (off < len) {
+        syscalls++;
+        ssize_t w = write(fd, data + off, len - off);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            int err = -errno;
+            close(fd);
+            unlink(tmp);
+            return err;
+        }
+        off += (size_t)w;
+    }
+
+    syscalls += 3;
+    if (fsync(fd) != 0 || close(fd) != 0 || rename(tmp, path) != 0) {
+        int err = -errno;
+        unlink(tmp);
+        return err;
+    }
+    return 0;
+}
+
+static size_t probe_blocking(const io_probe_t *t, size_t n, int *reachable) {
+    struct pollfd *pfd = calloc(n ? n : 1, sizeof(struct pollfd));
+    if (!pfd) return 0;
+
+    size_t waiting = 0;
+    for (size_t i = 0; i < n; i++) {
+        reachable[i] = 0;
+        pfd[i].fd = -1;
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(t[i].port);
+        if (!inet_aton(t[i].ip, &addr.sin_addr)) continue;
+
+        syscalls++;
+        int sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sock < 0) continue;
+
+        syscalls++;
+        if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            reachable[i] = 1;
+            syscalls++;
+            close(sock);
+        } else if (errno == EINPROGRESS) {
+            pfd[i].fd = sock;
+            pfd[i].events = POLLOUT;
+            waiting++;
+        } else {
+            syscalls++;
+            close(sock);
+        }
+    }
+
+    // Ждём все соединения разом, а не по одному с таймаутом на каждое
+    int timeout = PROBE_TIMEOUT_MS;
+    while (waiting > 0 && timeout > 0) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        syscalls++;
+        int ready = poll(pfd, n, timeout);
+        if (ready < 0 && errno != EINTR) break;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        timeout -= (int)((t1.tv_sec - t0.tv_sec) * 1000 + (t1.tv_nsec - t0.tv_nsec) / 1000000);
+
+        for (size_t i = 0; i < n && ready > 0; i++) {
+            if (pfd[i].fd < 0 || !pfd[i].revents) continue;
+
+            int err = 0;
+            socklen_t len = sizeof(err);
+            syscalls += 2;
+            getsockopt(pfd[i].fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            reachable[i] = err == 0;
+            close(pfd[i].fd);
+            pfd[i].fd = -1;
+            waiting--;
+        }
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (pfd[i].fd >= 0) {
+            syscalls++;
+            close(pfd[i].fd);
+        }
+        count += reachable[i] ? 1 : 0;
+    }
+    free(pfd);
+    return count;
+}
+
+/* ---------- io_uring путь ---------- */
+
+// Ошибка io_uring_enter посреди отправки оставляет в кольце неразобранные SQE и CQE —
+// следующая отправка их бы подхватила. Закрываем кольцо, дальше только блокирующий путь
+static void ring_abandon(int err) {
+    fprintf(stderr, "[-] io_uring_enter failed (%s), switching to blocking I/O\n", strerror(err));
+    ring_unmap(&ring);
+    use_uring = 0;
+}
+
+static void on_save_cqe(uint64_t user_data, int res, void *arg) {
+    pending_save_t *batch = (pending_save_t *)arg;
+    size_t idx = (size_t)(user_data >> 8);
+
+    // Короткая запись — тоже ошибка: ядро рвёт на ней цепочку, до renameat дело не доходит
+    if ((user_data & 0xff) == OP_WRITE && res >= 0 && (size_t)res != batch[idx].len) res = -EIO;
+
+    // В цепочке после первой ошибки остальные приходят с -ECANCELED — запоминаем первую
+    if (res < 0 && batch[idx].result == 0) batch[idx].result = res;
+}
+
+static void queue_save_chain(pending_save_t *s, size_t idx, unsigned slot) {
+    uint64_t ud = (uint64_t)idx << 8;
+    struct io_uring_sqe *sqe;
+
+    sqe = ring_get_sqe(&ring);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uintptr_t)s->tmp;
+    sqe->len = 0644;
+    // O_CLOEXEC с direct-дескриптором ядро отвергает: в таблицу fd он не попадает
+    sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+    sqe->file_index = slot + 1;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = ud | OP_OPEN;
+
+    sqe = ring_get_sqe(&ring);
+    sqe->opcode = s->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = (int)slot;
+    sqe->addr = (uintptr_t)s->data;
+    sqe->len = (unsigned)s->len;
+    sqe->off = 0;
+    sqe->buf_index = 0;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+    sqe->user_data = ud | OP_WRITE;
+
+    sqe = ring_get_sqe(&ring);
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = (int)slot;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+    sqe->user_data = ud | OP_FSYNC;
+
+    sqe = ring_get_sqe(&ring);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = slot + 1;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = ud | OP_CLOSE;
+
+    sqe = ring_get_sqe(&ring);
+    sqe->opcode = IORING_OP_RENAMEAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uintptr_t)s->tmp;
+    sqe->len = (unsigned)AT_FDCWD;
+    sqe->addr2 = (uintptr_t)s->path;
+    sqe->user_data = ud | OP_RENAME;
+}
+
+static int flush_uring(void) {
+    size_t per_round = ring.entries / SAVE_CHAIN_LEN;
+    if (per_round > IO_RING_FILES) per_round = IO_RING_FILES;
+
+    for (size_t done = 0; done < pending_count; ) {
+        size_t batch = pending_count - done;
+
+        if (!use_uring) {
+            // Кольцо закрыто в одном из прошлых раундов — остаток пишем обычными вызовами
+            for (size_t i = done; i < pending_count; i++) {
+                pending[i].result = save_blocking(pending[i].path, pending[i].tmp,
+                                                  pending[i].data, pending[i].len);
+            }
+            break;
+        }
+
+        if (batch > per_round) batch = per_round;
+        for (size_t i = 0; i < batch; i++) {
+            queue_save_chain(&pending[done + i], done + i, (unsigned)i);
+        }
+        if (ring_submit_and_reap(&ring, on_save_cqe, pending) != 0) {
+            // Какие цепочки раунда успели выполниться, неизвестно — считаем их неудачными
+            int err = errno;
+            ring_abandon(err);
+            for (size_t i = 0; i < batch; i++) {
+                if (pending[done + i].result == 0) pending[done + i].result = -err;
+            }
+        }
+        done += batch;
+    }
+    return 0;
+}
+
+static void on_probe_cqe(uint64_t user_data, int res, void *arg) {
+    int *reachable = (int *)arg;
+    if ((user_data & 0xff) == OP_CONNECT) {
+        reachable[user_data >> 8] = res == 0;
+    }
+}
+
+static void on_close_cqe(uint64_t user_data, int res, void *arg) {
+    (void)user_data;
+    (void)res;
+    (void)arg;
+}
+
+static size_t probe_uring(const io_probe_t *t, size_t n, int *reachable) {
+    struct sockaddr_in *addrs = calloc(n ? n : 1, sizeof(struct sockaddr_in));
+    if (!addrs) return 0;
+
+    static struct __kernel_timespec timeout = {
+        .tv_sec = PROBE_TIMEOUT_MS / 1000,
+        .tv_nsec = (PROBE_TIMEOUT_MS % 1000) * 1000000L,
+    };
+
+    size_t per_round = ring.entries / PROBE_CHAIN_LEN;
+    if (per_round > IO_RING_FILES) per_round = IO_RING_FILES;
+
+    for (size_t done = 0; done < n; ) {
+        if (!use_uring) {
+            // Кольцо закрыто после ошибки — остаток проверяем блокирующим путём
+            probe_blocking(t + done, n - done, reachable + done);
+            break;
+        }
+
+        size_t batch = n - done;
+        if (batch > per_round) batch = per_round;
+
+        unsigned used = 0;
+        for (size_t i = done; i < done + batch; i++) {
+            reachable[i] = 0;
+            addrs[i].sin_family = AF_INET;
+            addrs[i].sin_port = htons(t[i].port);
+            if (!inet_aton(t[i].ip, &addrs[i].sin_addr)) continue;
+
+            unsigned slot = used++;
+            uint64_t ud = (uint64_t)i << 8;
+            struct io_uring_sqe *sqe;
+
+            sqe = ring_get_sqe(&ring);
+            sqe->opcode = IORING_OP_SOCKET;
+            sqe->fd = AF_INET;
+            sqe->off = SOCK_STREAM;
+            sqe->file_index = slot + 1;
+            sqe->flags = IOSQE_IO_LINK;
+            sqe->user_data = ud | OP_SOCKET;
+
+            sqe = ring_get_sqe(&ring);
+            sqe->opcode = IORING_OP_CONNECT;
+            sqe->fd = (int)slot;
+            sqe->addr = (uintptr_t)&addrs[i];
+            sqe->off = sizeof(struct sockaddr_in);
+            sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+            sqe->user_data = ud | OP_CONNECT;
+
+            sqe = ring_get_sqe(&ring);
+            sqe->opcode = IORING_OP_LINK_TIMEOUT;
+            sqe->addr = (uintptr_t)&timeout;
+            sqe->len = 1;
+            sqe->user_data = ud | OP_TIMEOUT;
+        }
+
+        if (used > 0) {
+            if (ring_submit_and_reap(&ring, on_probe_cqe, reachable) != 0) {
+                // Результаты раунда неполные — он уйдёт в блокирующую проверку целиком
+                ring_abandon(errno);
+                continue;
+            }
+
+            // Закрываем все сокеты раунда ещё одной отправкой
+            for (unsigned slot = 0; slot < used; slot++) {
+                struct io_uring_sqe *sqe = ring_get_sqe(&ring);
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->file_index = slot + 1;
+                sqe->user_data = OP_CLOSE;
+            }
+            if (ring_submit_and_reap(&ring, on_close_cqe, NULL) != 0) ring_abandon(errno);
+        }
+        done += batch;
+    }
+
+    free(addrs);
+
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) count += reachable[i] ? 1 : 0;
+    return count;
+}
+
+/* ---------- общий интерфейс ---------- */
+
+int io_batch_init(int prefer_uring) {
+    if (initialized) return 0;
+    initialized = 1;
+    use_uring = 0;
+    syscalls = 0;
+
+    pending = calloc(IO_BATCH_MAX, sizeof(pending_save_t));
+    if (!pending) return -1;
+
+    if (!prefer_uring) return 0;
+
+    if (ring_setup(&ring, IO_RING_ENTRIES) != 0) {
+        fprintf(stderr, "[-] io_uring unavailable (%s), using blocking I/O\n", strerror(errno));
+        return 0;
+    }
+    if (!ring_supports_ops(&ring)) {
+        fprintf(stderr, "[-] io_uring lacks required ops, using blocking I/O\n");
+        ring_unmap(&ring);
+        return 0;
+    }
+
+    // Разреженная таблица фиксированных дескрипторов: слоты заполняют openat/socket
+    int files[IO_RING_FILES];
+    for (int i = 0; i < IO_RING_FILES; i++) files[i] = -1;
+    if (sys_io_uring_register(ring.fd, IORING_REGISTER_FILES, files, IO_RING_FILES) != 0) {
+        fprintf(stderr, "[-] io_uring file table failed, using blocking I/O\n");
+        ring_unmap(&ring);
+        return 0;
+    }
+
+    arena = mmap(NULL, IO_RING_ARENA, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    struct iovec iov = { arena, IO_RING_ARENA };
+    if (arena == MAP_FAILED ||
+        sys_io_uring_register(ring.fd, IORING_REGISTER_BUFFERS, &iov, 1) != 0) {
+        // Без зарегистрированного буфера тоже работаем — обычным write
+        if (arena != MAP_FAILED) munmap(arena, IO_RING_ARENA);
+        arena = NULL;
+    }
+
+    use_uring = 1;
+    return 0;
+}
+
+const char *io_batch_backend(void) {
+    return use_uring ? "io_uring" : "blocking";
+}
+
+int io_save_file(const char *path, const char *data, size_t len) {
+    if (!initialized && io_batch_init(1) != 0) return -1;
+
+    char tmp[PATH_MAX];
+    int res = snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    if (res < 0 || (size_t)res >= sizeof(tmp)) return -1;
+
+    if (!use_uring) {
+        int err = save_blocking(path, tmp, data, len);
+        if (err != 0) {
+            fprintf(stderr, "[-] Save failed: %s: %s\n", path, strerror(-err));
+            return -1;
+        }
+        printf("[+] Saved: %s\n", path);
+        return 0;
+    }
+
+    if (pending_count == IO_BATCH_MAX ||
+        (arena && len <= IO_RING_ARENA && arena_used + len > IO_RING_ARENA)) {
+        io_flush();
+    }
+
+    char *buf;
+    int fixed = arena && len <= IO_RING_ARENA;
+    if (fixed) {
+        buf = arena + arena_used;
+        arena_used += len;
+    } else {
+        buf = malloc(len ? len : 1);
+        if (!buf) return -1;
+    }
+    memcpy(buf, data, len);
+
+    // Повторное сохранение того же пути в одной пачке заменяет прежнее: иначе две
+    // цепочки параллельно пишут в один .tmp и одна из renameat падает с ENOENT
+    pending_save_t *s = NULL;
+    for (size_t i = 0; i < pending_count; i++) {
+        if (strcmp(pending[i].path, path) == 0) {
+            s = &pending[i];
+            break;
+        }
+    }
+
+    if (s) {
+        if (!s->fixed) free(s->data);
+    } else {
+        s = &pending[pending_count++];
+        memset(s, 0, sizeof(*s));
+        snprintf(s->path, sizeof(s->path), "%s", path);
+        memcpy(s->tmp, tmp, (size_t)res + 1);
+    }
+    s->data = buf;
+    s->len = len;
+    s->fixed = fixed;
+    return 0;
+}
+
+int io_flush(void) {
+    // Очередь не пуста и без io_uring, если кольцо закрыли после ошибки отправки
+    if (pending_count == 0) return 0;
+
+    flush_uring();
+
+    int failed = 0;
+    for (size_t i = 0; i < pending_count; i++) {
+        pending_save_t *s = &pending[i];
+        if (s->result == 0) {
+            printf("[+] Saved: %s\n", s->path);
+        } else {
+            fprintf(stderr, "[-] Save failed: %s: %s\n", s->path, strerror(-s->result));
+            unlink(s->tmp);
+            failed++;
+        }
+        if (!s->fixed) free(s->data);
+    }
+
+    pending_count = 0;
+    arena_used = 0;
+    return failed;
+}
+
+void io_discard(void) {
+    for (size_t i = 0; i < pending_count; i++) {
+        if (!pending[i].fixed) free(pending[i].data);
+    }
+    pending_count = 0;
+    arena_used = 0;
+}
+
+size_t io_probe_batch(const io_probe_t *targets, size_t n, int *reachable) {
+    if (!initialized && io_batch_init(1) != 0) return 0;
+    return use_uring ? probe_uring(targets, n, reachable) : probe_blocking(targets, n, reachable);
+}
+
+unsigned long io_batch_syscalls(void) {
+    return syscalls;
+}
+
+void io_batch_cleanup(void) {
+    if (!initialized) return;
+
+    io_flush();
+    if (use_uring) ring_unmap(&ring);
+    if (arena) munmap(arena, IO_RING_ARENA);
+    arena = NULL;
+    free(pending);
+    pending = NULL;
+    use_uring = 0;
+    initialized = 0;
+}
@@ -0,0 +1,76 @@
+// source/daemon/io/io_batch.h
+#ifndef IO_BATCH_H
+#define IO_BATCH_H
+
+#include <stddef.h>
+
+/**
+ * @brief Пакетный ввод-вывод демона: io_uring с откатом на блокирующие вызовы.
+ *
+ * Сохранение конфигов копится в очереди и уходит одной отправкой в кольцо:
+ * на каждый файл — связанная цепочка openat -> write -> fsync -> close -> renameat
+ * (запись во временный файл и атомарная подмена). Данные копируются в
+ * заранее зарегистрированный буфер (write_fixed), файлы открываются сразу
+ * в таблицу фиксированных дескрипторов.
+ *
+ * Проверки доступности — цепочки socket -> connect + link_timeout, по одной
+ * на сервер, все одной отправкой.
+ *
+ * Нужно ядро 5.19+ (socket и direct-дескрипторы в io_uring). На старом ядре,
+ * при запрете io_uring или при VPN_IO=blocking используется прежний путь:
+ * обычные open/write/fsync/close/rename и неблокирующий connect + poll.
+ */
+
+typedef struct {
+    const char *ip;
+    int port;
+} io_probe_t;
+
+/**
+ * @brief Выбирает бэкенд.
+ * @param prefer_uring — 0: сразу блокирующий путь
+ * @return 0 при успехе (любой бэкенд), -1 при ошибке
+ */
+int io_batch_init(int prefer_uring);
+
+/**
+ * @brief Имя активного бэкенда: "io_uring" или "blocking".
+ */
+const char *io_batch_backend(void);
+
+/**
+ * @brief Атомарно сохраняет файл.
+ *
+ * С io_uring запись только ставится в очередь (данные копируются) и
+ * выполняется в io_flush() или при заполнении очереди.
+ *
+ * @return 0 при успехе/постановке в очередь, -1 при ошибке
+ */
+int io_save_file(const char *path, const char *data, size_t len);
+
+/**
+ * @brief Выполняет всё, что накоплено в очереди.
+ * @return число неудачных записей
+ */
+int io_flush(void);
+
+/**
+ * @brief Отбрасывает накопленные сохранения, ничего не записывая.
+ */
+void io_discard(void);
+
+/**
+ * @brief Проверяет TCP-доступность серверов пачкой (таймаут PROBE_TIMEOUT_MS).
+ * @param reachable — массив из n флагов результата
+ * @return число доступных серверов
+ */
+size_t io_probe_batch(const io_probe_t *targets, size_t n, int *reachable);
+
+/**
+ * @brief Сколько системных вызовов ввода-вывода сделано с момента init.
+ */
+unsigned long io_batch_syscalls(void);
+
+void io_batch_cleanup(void);
+
+#endif
@@ -4,125 +4,286 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include "../../../database/redis/utils/redis_store.h"
+#include <ctype.h>
+#include "parser.h"
+#include "sites.h"
+#include "../../../config/config.h"
+
+#define MAX_ROW_CELLS 16
 
 /**
- * @brief Извлекает данные о серверах с vpngate.net и сохраняет в Redis.
- * @param html — тело HTML-страницы
- * @param redis_ctx — подключение к Redis
+ * @brief Скомпилированные выражения одного сайта (индекс = индекс в SUPPORTED_SITES).
  */
-void extract_vpngate_servers(const char *html, redisContext *redis_ctx) {
-    htmlDocPtr doc = htmlReadDoc((xmlChar*)html, NULL, NULL,
-                                 HTML_PARSE_RECOVER | HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
-    if (!doc) return;
-
-    // XPath к строкам таблицы (пропускаем заголовок)
-    xmlXPathContextPtr xpathCtx = xmlXPathNewContext(doc);
-    xmlXPathObjectPtr xpathObj = xmlXPathEvalExpression(
-        (xmlChar*)"//table[@id='vg_hosts_table_id']//tr[position()>1]", xpathCtx);
-
-    if (xpathObj && xpathObj->nodesetval) {
-        for (int i = 0; i < xpathObj->nodesetval->nodeNr; i++) {
-            xmlNodePtr row = xpathObj->nodesetval->nodeTab[i];
-            xmlNodePtr cell = row->children;
-
-            // Пропускаем пустые ячейки
-            while (cell && cell->type != XML_ELEMENT_NODE) cell = cell->next;
-            if (!cell) continue;
-
-            // IP находится в первой ячейке (внутри <span>)
-            xmlChar *ip = xmlNodeGetContent(cell->children);
-            if (!ip || strlen((char*)ip) < 7) {
-                xmlFree(ip);
-                continue;
-            }
+typedef struct {
+    xmlXPathCompExprPtr links;
+    xmlXPathCompExprPtr rows;
+} site_exprs_t;
 
-            // Переходим к порту (3-я ячейка)
-            int col = 0;
-            xmlNodePtr cur = row->children;
-            while (cur && col < 3) {
-                if (cur->type == XML_ELEMENT_NODE) col++;
-                if (col < 3) cur = cur->next;
-            }
+static site_exprs_t compiled[SITE_COUNT];
+static xmlXPathCompExprPtr cell_link_expr;
+static int initialized;
 
-            int port = 0;
-            if (cur && cur->children) {
-                xmlChar *port_str = xmlNodeGetContent(cur->children);
-                port = atoi((char*)port_str);
-                xmlFree(port_str);
-            }
+int extractor_init(void) {
+    if (initialized) return 0;
 
-            // Страна — 2-я ячейка
-            col = 0;
-            cur = row->children;
-            while (cur && col < 2) {
-                if (cur->type == XML_ELEMENT_NODE) col++;
-                if (col < 2) cur = cur->next;
-            }
-            xmlChar *country = NULL;
-            if (cur && cur->children && cur->children->next) {
-                country = xmlGetProp(cur->children->next, (xmlChar*)"alt");
-            }
+    cell_link_expr = xmlXPathCompile((xmlChar*)".//a[contains(@href, '.ovpn')]/@href");
+    if (!cell_link_expr) return -1;
+
+    for (size_t i = 0; i < SITE_COUNT; i++) {
+        const vpn_site_t *site = &SUPPORTED_SITES[i];
 
-            // Скорость — 4-я ячейка
-            col = 0;
-            cur = row->children;
-            while (cur && col < 4) {
-                if (cur->type == XML_ELEMENT_NODE) col++;
-                if (col < 4) cur = cur->next;
+        if (site->link_xpath) {
+            compiled[i].links = xmlXPathCompile((xmlChar*)site->link_xpath);
+            if (!compiled[i].links) {
+                fprintf(stderr, "[-] Bad link XPath for %s\n", site->name);
+                extractor_cleanup();
+                return -1;
             }
-            double score = 0.0;
-            if (cur && cur->children) {
-                xmlChar *speed_str = xmlNodeGetContent(cur->children);
-                // Убираем " Mbps"
-                char *end = strstr((char*)speed_str, " ");
-                if (end) *end = '\0';
-                score = atof((char*)speed_str);
-                xmlFree(speed_str);
+        }
+        if (site->row_xpath) {
+            compiled[i].rows = xmlXPathCompile((xmlChar*)site->row_xpath);
+            if (!compiled[i].rows) {
+                fprintf(stderr, "[-] Bad row XPath for %s\n", site->name);
+                extractor_cleanup();
+                return -1;
             }
+        }
+    }
 
-            // Ссылка на .ovpn — ищем в 7-й ячейке
-            col = 0;
-            cur = row->children;
-            while (cur && col < 7) {
-                if (cur->type == XML_ELEMENT_NODE) col++;
-                if (col < 7) cur = cur->next;
-            }
-            xmlChar *ovpn_url = NULL;
-            if (cur) {
-                xmlXPathContextPtr cellCtx = xmlXPathNewContext(doc);
-                cellCtx->node = cur;
-                xmlXPathObjectPtr linkObj = xmlXPathEvalExpression(
-                    (xmlChar*)".//a[contains(@href, '.ovpn')]/@href", cellCtx);
-                if (linkObj && linkObj->nodesetval && linkObj->nodesetval->nodeTab[0]) {
-                    ovpn_url = xmlNodeGetContent(linkObj->nodesetval->nodeTab[0]);
-                }
-                xmlXPathFreeObject(linkObj);
-                xmlXPathFreeContext(cellCtx);
+    initialized = 1;
+    return 0;
+}
+
+void extractor_cleanup(void) {
+    for (size_t i = 0; i < SITE_COUNT; i++) {
+        if (compiled[i].links) xmlXPathFreeCompExpr(compiled[i].links);
+        if (compiled[i].rows) xmlXPathFreeCompExpr(compiled[i].rows);
+        compiled[i].links = NULL;
+        compiled[i].rows = NULL;
+    }
+    if (cell_link_expr) xmlXPathFreeCompExpr(cell_link_expr);
+    cell_link_expr = NULL;
+    initialized = 0;
+}
+
+// Относительную ссылку достраиваем от base_url сайта
+static void resolve_url(const vpn_site_t *site, const char *href, char *out, size_t len) {
+    if (strncmp(href, "http", 4) == 0) {
+        snprintf(out, len, "%s", href);
+    } else {
+        snprintf(out, len, "%s%s", site->base_url, href);
+    }
+}
+
+static xmlNodePtr find_img(xmlNodePtr node) {
+    for (xmlNodePtr cur = node; cur; cur = cur->next) {
+        if (cur->type != XML_ELEMENT_NODE) continue;
+        if (xmlStrcasecmp(cur->name, (xmlChar*)"img") == 0) return cur;
+        xmlNodePtr img = find_img(cur->children);
+        if (img) return img;
+    }
+    return NULL;
+}
+
+/* ---------- декодеры полей ---------- */
+
+static int decode_text(xmlDocPtr doc, xmlXPathContextPtr ctx, xmlNodePtr cell, char *out, size_t len) {
+    (void)doc;
+    (void)ctx;
+    xmlChar *text = xmlNodeGetContent(cell);
+    if (!text) return -1;
+
+    const char *s = (const char*)text;
+    while (isspace((unsigned char)*s)) s++;
+    size_t n = strlen(s);
+    while (n > 0 && isspace((unsigned char)s[n - 1])) n--;
+    if (n >= len) n = len - 1;
+    memcpy(out, s, n);
+    out[n] = '\0';
+
+    xmlFree(text);
+    return n > 0 ? 0 : -1;
+}
+
+static int decode_img_alt(xmlDocPtr doc, xmlXPathContextPtr ctx, xmlNodePtr cell, char *out, size_t len) {
+    (void)doc;
+    (void)ctx;
+    xmlNodePtr img = find_img(cell->children);
+    if (!img) return -1;
+
+    xmlChar *alt = xmlGetProp(img, (xmlChar*)"alt");
+    if (!alt) return -1;
+    snprintf(out, len, "%s", (char*)alt);
+    xmlFree(alt);
+    return 0;
+}
+
+static int decode_number(xmlDocPtr doc, xmlXPathContextPtr ctx, xmlNodePtr cell, char *out, size_t len) {
+    char text[128];
+    if (decode_text(doc, ctx, cell, text, sizeof(text)) != 0) return -1;
+
+    // Берём числовой префикс, запятые-разделители разрядов выбрасываем
+    size_t n = 0;
+    for (const char *p = text; *p && n + 1 < len; p++) {
+        if (isdigit((unsigned char)*p) || *p == '.') out[n++] = *p;
+        else if (*p != ',') break;
+    }
+    out[n] = '\0';
+    return n > 0 ? 0 : -1;
+}
+
+static int decode_ovpn_link(xmlDocPtr doc, xmlXPathContextPtr ctx, xmlNodePtr cell, char *out, size_t len) {
+    (void)doc;
+    ctx->node = cell;
+    xmlXPathObjectPtr obj = xmlXPathCompiledEval(cell_link_expr, ctx);
+
+    int rc = -1;
+    if (obj && obj->nodesetval && obj->nodesetval->nodeNr > 0) {
+        xmlChar *href = xmlNodeGetContent(obj->nodesetval->nodeTab[0]);
+        if (href) {
+            snprintf(out, len, "%s", (char*)href);
+            xmlFree(href);
+            rc = 0;
+        }
+    }
+    xmlXPathFreeObject(obj);
+    return rc;
+}
+
+static int decode_proto(xmlDocPtr doc, xmlXPathContextPtr ctx, xmlNodePtr cell, char *out, size_t len) {
+    char text[128];
+    if (decode_text(doc, ctx, cell, text, sizeof(text)) != 0) return -1;
+
+    // Приводим к тем же "tcp"/"udp", что и в ключах Redis
+    for (char *p = text; *p; p++) *p = (char)tolower((unsigned char)*p);
+    int tcp = strstr(text, "tcp") != NULL;
+    int udp = strstr(text, "udp") != NULL;
+    if (tcp == udp) return -1;
+
+    snprintf(out, len, "%s", tcp ? "tcp" : "udp");
+    return 0;
+}
+
+typedef int (*decoder_fn)(xmlDocPtr, xmlXPathContextPtr, xmlNodePtr, char *, size_t);
+
+// Индекс — значение field_decoder_t
+static const decoder_fn DECODERS[] = {
+    [FIELD_TEXT]      = decode_text,
+    [FIELD_IMG_ALT]   = decode_img_alt,
+    [FIELD_NUMBER]    = decode_number,
+    [FIELD_OVPN_LINK] = decode_ovpn_link,
+    [FIELD_PROTO]     = decode_proto,
+};
+
+static int decode_field(const site_field_t *field, xmlDocPtr doc, xmlXPathContextPtr ctx,
+                        xmlNodePtr *cells, int ncells, char *out, size_t len) {
+    out[0] = '\0';
+    if (field->col <= 0 || field->col > ncells) return -1;
+    return DECODERS[field->decode](doc, ctx, cells[field->col - 1], out, len);
+}
+
+/* ---------- извлечение ---------- */
+
+static void extract_links(size_t idx, xmlXPathContextPtr ctx, const site_sink_t *sink) {
+    const vpn_site_t *site = &SUPPORTED_SITES[idx];
+    xmlXPathObjectPtr obj = xmlXPathCompiledEval(compiled[idx].links, ctx);
+
+    if (obj && obj->nodesetval) {
+        for (int i = 0; i < obj->nodesetval->nodeNr; i++) {
+            xmlChar *href = xmlGetProp(obj->nodesetval->nodeTab[i], (xmlChar*)"href");
+            if (!href) continue;
+
+            char full_url[2048];
+            resolve_url(site, (char*)href, full_url, sizeof(full_url));
+            sink->on_link(full_url, sink->arg);
+            xmlFree(href);
+        }
+    }
+    xmlXPathFreeObject(obj);
+}
+
+static int extract_rows(size_t idx, xmlDocPtr doc, xmlXPathContextPtr ctx, const site_sink_t *sink) {
+    const vpn_site_t *site = &SUPPORTED_SITES[idx];
+    xmlXPathObjectPtr obj = xmlXPathCompiledEval(compiled[idx].rows, ctx);
+    int count = 0;
+
+    if (obj && obj->nodesetval) {
+        for (int i = 0; i < obj->nodesetval->nodeNr && count < MAX_SERVERS_PER_SITE; i++) {
+            // Один проход по строке: собираем ячейки, дальше доступ по номеру колонки
+            xmlNodePtr cells[MAX_ROW_CELLS];
+            int ncells = 0;
+            for (xmlNodePtr cur = obj->nodesetval->nodeTab[i]->children;
+                 cur && ncells < MAX_ROW_CELLS; cur = cur->next) {
+                if (cur->type == XML_ELEMENT_NODE) cells[ncells++] = cur;
             }
 
-            if (ovpn_url && port > 0) {
-                char full_url[1024];
-                snprintf(full_url, sizeof(full_url), "https://www.vpngate.net%s", ovpn_url);
+            char ip[64], country[64], port_str[16], score_str[32], href[1024], proto[8];
+            if (decode_field(&site->ip, doc, ctx, cells, ncells, ip, sizeof(ip)) != 0 ||
+                strlen(ip) < 7) {
+                continue;
+            }
+            decode_field(&site->country, doc, ctx, cells, ncells, country, sizeof(country));
+            decode_field(&site->port, doc, ctx, cells, ncells, port_str, sizeof(port_str));
+            decode_field(&site->score, doc, ctx, cells, ncells, score_str, sizeof(score_str));
+            decode_field(&site->link, doc, ctx, cells, ncells, href, sizeof(href));
 
-                // Определяем протокол по порту (грубая эвристика)
-                const char *proto = (port == 443 || port == 53) ? "tcp" : "udp";
+            int port = atoi(port_str);
+            if (!href[0] || port <= 0) continue;
 
-                redis_save_vpn_server(
-                    redis_ctx, "vpngate",
-                    (char*)ip, port, proto,
-                    country ? (char*)country : "??",
-                    score, full_url
-                );
+            if (site->proto.col > 0) {
+                // Колонка протокола есть, но значение не разобрали — строку не угадываем
+                if (decode_field(&site->proto, doc, ctx, cells, ncells, proto, sizeof(proto)) != 0) continue;
+            } else {
+                // Колонки нет — грубая эвристика по порту
+                snprintf(proto, sizeof(proto), "%s", (port == 443 || port == 53) ? "tcp" : "udp");
             }
 
-            xmlFree(ip);
-            if (country) xmlFree(country);
-            if (ovpn_url) xmlFree(ovpn_url);
+            char full_url[2048];
+            resolve_url(site, href, full_url, sizeof(full_url));
+
+            vpn_server_t server = {
+                .ip = ip,
+                .port = port,
+                .protocol = proto,
+                .country = country[0] ? country : "??",
+                .score = atof(score_str),
+                .config_url = full_url,
+                .source = site->name,
+            };
+            sink->on_server(&server, sink->arg);
+            count++;
         }
     }
+    xmlXPathFreeObject(obj);
+    return count;
+}
+
+int extract_site(size_t idx, const char *html, const site_sink_t *sink) {
+    if (idx >= SITE_COUNT || !html || !sink) return -1;
+    if (!initialized && extractor_init() != 0) return -1;
+
+    htmlDocPtr doc = htmlReadDoc((xmlChar*)html, NULL, NULL,
+                                 HTML_PARSE_RECOVER | HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
+    if (!doc) {
+        fprintf(stderr, "[-] Failed to parse HTML from %s\n", SUPPORTED_SITES[idx].name);
+        return -1;
+    }
+
+    xmlXPathContextPtr ctx = xmlXPathNewContext(doc);
+    if (!ctx) {
+        xmlFreeDoc(doc);
+        return -1;
+    }
+
+    int count = 0;
+    if (sink->on_link && compiled[idx].links) {
+        extract_links(idx, ctx, sink);
+    }
+    if (sink->on_server && compiled[idx].rows) {
+        count = extract_rows(idx, doc, ctx, sink);
+    }
 
-    xmlXPathFreeObject(xpathObj);
-    xmlXPathFreeContext(xpathCtx);
+    xmlXPathFreeContext(ctx);
     xmlFreeDoc(doc);
-}
\ No newline at end of file
+    return count;
+}
@@ -1,11 +1,11 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-#include <hiredis/hiredis.h>
+#include <stddef.h>
 
 typedef struct {
 
-    const char *p;
+    const char *ip;
     int port;
     const char *protocol;
 
@@ -17,6 +17,32 @@ typedef struct {
 
 } vpn_server_t;
 
-int parse_vpn_page(const char *html, const char *source_name, redisContext *redis_ctx);
-
-#endif
\ No newline at end of file
+/**
+ * @brief Куда отдаёт результаты экстрактор сайта.
+ * Любой из обработчиков может быть NULL.
+ */
+typedef struct {
+    void (*on_link)(const char *url, void *arg);                // найдена ссылка на .ovpn
+    void (*on_server)(const vpn_server_t *server, void *arg);   // строка таблицы серверов
+    void *arg;
+} site_sink_t;
+
+/**
+ * @brief Компилирует XPath всех сайтов из SUPPORTED_SITES. Вызывается один раз при старте.
+ * @return 0 при успехе, -1 при ошибке
+ */
+int extractor_init(void);
+
+/**
+ * @brief Освобождает скомпилированные выражения.
+ */
+void extractor_cleanup(void);
+
+/**
+ * @brief Разбирает страницу сайта по его записи в реестре.
+ * @param site — индекс в SUPPORTED_SITES
+ * @return число найденных серверов или -1 при ошибке
+ */
+int extract_site(size_t site, const char *html, const site_sink_t *sink);
+
+#endif
@@ -2,22 +2,66 @@
 #ifndef SITES_H
 #define SITES_H
 
+/**
+ * @brief Декодер значения ячейки таблицы серверов.
+ */
+typedef enum {
+    FIELD_TEXT = 0,     // текст ячейки без пробелов по краям
+    FIELD_IMG_ALT,      // атрибут alt первой картинки (флаг страны)
+    FIELD_NUMBER,       // число в начале текста ("12.5 Mbps" -> "12.5")
+    FIELD_OVPN_LINK,    // href первой ссылки на .ovpn внутри ячейки
+    FIELD_PROTO,        // "tcp" или "udp" по тексту ячейки ("TCP", "OpenVPN UDP")
+} field_decoder_t;
+
+/**
+ * @brief Колонка таблицы: номер (с 1, 0 — нет такой колонки) и декодер.
+ */
+typedef struct {
+    int col;
+    field_decoder_t decode;
+} site_field_t;
+
 /**
  * @brief Список поддерживаемых сайтов с метаданными.
- * Расширяем: просто добавьте новую запись.
+ * Расширяем: просто добавьте новую запись — XPath компилируется при старте,
+ * обработка идёт по индексу записи.
  */
 typedef struct {
     const char *name;      // Уникальное имя (для логов и Redis-ключей)
     const char *url;       // URL для парсинга
     const char *base_url;  // База для относительных ссылок
+
+    const char *link_xpath;  // Ссылки на .ovpn на странице
+    const char *row_xpath;   // Строки таблицы серверов (NULL — таблицы нет)
+
+    site_field_t ip;
+    site_field_t country;
+    site_field_t port;
+    site_field_t score;
+    site_field_t link;
+    site_field_t proto;      // 0 — колонки нет, протокол угадываем по порту
 } vpn_site_t;
 
 static const vpn_site_t SUPPORTED_SITES[] = {
-    {"vpngate", "https://www.vpngate.net/en/", "https://www.vpngate.net"},
-    {"vpnbook", "https://www.vpnbook.com/freevpn", "https://www.vpnbook.com"},
+    {
+        "vpngate", "https://www.vpngate.net/en/", "https://www.vpngate.net",
+        "//a[@href and contains(@href, '.ovpn')]",
+        "//table[@id='vg_hosts_table_id']//tr[position()>1]",
+        .ip      = {1, FIELD_TEXT},
+        .country = {2, FIELD_IMG_ALT},
+        .port    = {3, FIELD_NUMBER},
+        .score   = {4, FIELD_NUMBER},
+        .link    = {7, FIELD_OVPN_LINK},
+        .proto   = {0, FIELD_PROTO},    // отдельной колонки нет: TCP и UDP в одной ячейке
+    },
+    {
+        "vpnbook", "https://www.vpnbook.com/freevpn", "https://www.vpnbook.com",
+        .link_xpath = "//a[@href and contains(@href, '.ovpn')]",
+        .row_xpath  = NULL,
+    },
 
 };
 
 #define SITE_COUNT (sizeof(SUPPORTED_SITES) / sizeof(SUPPORTED_SITES[0]))
 
-#endif
\ No newline at end of file
+#endif
@@ -6,4 +6,15 @@
 #define BUFFER_SIZE 1024          // Размер буфера для приёма данных
 #define MAX_CLIENTS 100           // Максимальное количество клиентов одновременно
 
+#define QUERY_MAX_K 100           // Максимальный K в запросе TOP
+#define QUERY_CACHE_SLOTS 256     // Слотов в кеше результатов запросов
+#define QUERY_REFRESH_SEC 30      // Период перечитывания серверов из Redis
+#define RESPONSE_SIZE 65536       // Размер буфера ответа на запрос
+
+#define HANDOFF_DIR_NAME "vpn_server"    // Каталог управляющего сокета hot restart (0700)
+#define HANDOFF_FALLBACK_DIR "/tmp"      // Где его создать, если не задан XDG_RUNTIME_DIR
+#define HANDOFF_SOCKET "handoff.sock"    // Имя управляющего сокета в каталоге
+#define HANDOFF_TIMEOUT_SEC 5            // Таймаут обмена по управляющему сокету
+#define DRAIN_TIMEOUT_SEC 30      // Сколько старый процесс ждёт завершения соединений
+
 #endif // SERV_CONFIG_H
@@ -0,0 +1,211 @@
+// source/server/handoff/handoff.c
+#define _GNU_SOURCE     // struct ucred
+
+#include "handoff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "../config/serv_config.h"
+
+#define HANDOFF_ACK 'K'
+
+static int fill_addr(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "Handoff path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+int handoff_path(char *buf, size_t len) {
+    char dir[256];
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime && runtime[0] == '/') {
+        snprintf(dir, sizeof(dir), "%s/%s", runtime, HANDOFF_DIR_NAME);
+    } else {
+        snprintf(dir, sizeof(dir), "%s/%s-%u", HANDOFF_FALLBACK_DIR, HANDOFF_DIR_NAME, (unsigned)geteuid());
+    }
+
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Handoff dir %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    // Каталог мог создать кто-то другой заранее — тогда им не пользуемся
+    struct stat st;
+    if (lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) ||
+        st.st_uid != geteuid() || (st.st_mode & 077) != 0) {
+        fprintf(stderr, "Handoff dir %s is not private to this user\n", dir);
+        return -1;
+    }
+
+    int n = snprintf(buf, len, "%s/%s", dir, HANDOFF_SOCKET);
+    return n < 0 || (size_t)n >= len ? -1 : 0;
+}
+
+// Собеседник на управляющем сокете должен работать под тем же пользователем
+static int peer_is_trusted(int sock) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) return 0;
+    if (cred.uid != geteuid()) {
+        fprintf(stderr, "Handoff: rejected peer pid %d uid %u\n", (int)cred.pid, (unsigned)cred.uid);
+        return 0;
+    }
+    return 1;
+}
+
+// Зависший собеседник не должен держать ни старый, ни новый процесс
+static int set_timeouts(int sock) {
+    struct timeval tv = { .tv_sec = HANDOFF_TIMEOUT_SEC, .tv_usec = 0 };
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0 ||
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) != 0) {
+        perror("Handoff setsockopt failed");
+        return -1;
+    }
+    return 0;
+}
+
+int handoff_receive(const char *path, int *fds) {
+    struct sockaddr_un addr;
+    if (fill_addr(&addr, path) != 0) return -1;
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) return -1;
+
+    if (set_timeouts(sock) != 0 ||
+        connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || !peer_is_trusted(sock)) {
+        close(sock);
+        return -1;
+    }
+
+    char count = 0;
+    struct iovec iov = { .iov_base = &count, .iov_len = 1 };
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+
+    struct cmsghdr *cmsg = n > 0 ? CMSG_FIRSTHDR(&msg) : NULL;
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+        fprintf(stderr, "Handoff: no descriptors received\n");
+        close(sock);
+        return -1;
+    }
+
+    int received = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+    if (received > HANDOFF_MAX_FDS) received = HANDOFF_MAX_FDS;
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * received);
+
+    // Проверяем, что нам отдали именно слушающие сокеты
+    for (int i = 0; i < received; i++) {
+        int listening = 0;
+        socklen_t len = sizeof(listening);
+        if (getsockopt(fds[i], SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) < 0 || !listening) {
+            fprintf(stderr, "Handoff: descriptor %d is not a listening socket\n", fds[i]);
+            for (int j = 0; j < received; j++) close(fds[j]);
+            close(sock);
+            return -1;
+        }
+    }
+
+    // Подтверждение: только после него старый процесс прекращает accept()
+    char ack = HANDOFF_ACK;
+    if (write(sock, &ack, 1) != 1) {
+        for (int i = 0; i < received; i++) close(fds[i]);
+        close(sock);
+        return -1;
+    }
+
+    close(sock);
+    return received;
+}
+
+int handoff_listen(const char *path) {
+    struct sockaddr_un addr;
+    if (fill_addr(&addr, path) != 0) return -1;
+
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        perror("Handoff socket failed");
+        return -1;
+    }
+
+    // Путь мог остаться от предыдущего процесса — он свой сокет уже отдал
+    unlink(path);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 1) < 0) {
+        perror("Handoff bind failed");
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int handoff_serve(int ctl_fd, const int *fds, int count) {
+    if (count <= 0 || count > HANDOFF_MAX_FDS) return -1;
+
+    for (;;) {
+        int peer = accept(ctl_fd, NULL, NULL);
+        if (peer < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (!peer_is_trusted(peer) || set_timeouts(peer) != 0) {
+            close(peer);
+            continue;
+        }
+
+        char tag = (char)count;
+        struct iovec iov = { .iov_base = &tag, .iov_len = 1 };
+        union {
+            char buf[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+            struct cmsghdr align;
+        } control;
+        memset(&control, 0, sizeof(control));
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+
+        char ack = 0;
+        if (sendmsg(peer, &msg, MSG_NOSIGNAL) == 1 && read(peer, &ack, 1) == 1 && ack == HANDOFF_ACK) {
+            close(peer);
+            return 0;
+        }
+
+        // Новый процесс не подтвердил — продолжаем работать сами
+        fprintf(stderr, "Handoff not acknowledged, keeping listeners\n");
+        close(peer);
+    }
+}
@@ -0,0 +1,59 @@
+// source/server/handoff/handoff.h
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+/**
+ * @brief Передача слушающих сокетов новому процессу (hot restart).
+ *
+ * Работающий сервер слушает управляющий Unix-сокет. Новый бинарник,
+ * запущенный с --hot-restart, подключается к нему и получает слушающие
+ * дескрипторы через SCM_RIGHTS, после чего подтверждает приём одним байтом.
+ * Только после подтверждения старый процесс перестаёт принимать соединения
+ * и дожидается завершения текущих. Сокет не закрывается ни на миг, поэтому
+ * клиенты не видят connection refused.
+ *
+ * Управляющий сокет лежит в личном каталоге 0700 ($XDG_RUNTIME_DIR/vpn_server
+ * или /tmp/vpn_server-<uid>), и обе стороны сверяют uid собеседника
+ * (SO_PEERCRED): чужой процесс не может ни перехватить путь, ни подсунуть сокет.
+ */
+
+#define HANDOFF_MAX_FDS 8
+
+#include <stddef.h>
+
+/**
+ * @brief Путь управляющего сокета; каталог создаётся при необходимости.
+ *
+ * Каталог должен принадлежать текущему пользователю и не быть доступен
+ * группе и остальным — иначе путь считается перехваченным.
+ *
+ * @return 0 при успехе, -1 если безопасного каталога нет
+ */
+int handoff_path(char *buf, size_t len);
+
+/**
+ * @brief Забирает слушающие сокеты у работающего процесса.
+ * @param path — путь управляющего сокета
+ * @param fds — массив для дескрипторов (не меньше HANDOFF_MAX_FDS)
+ * @return число полученных дескрипторов или -1, если старого процесса нет
+ */
+int handoff_receive(const char *path, int *fds);
+
+/**
+ * @brief Создаёт управляющий сокет (старый файл по пути заменяется).
+ * @return дескриптор или -1 при ошибке
+ */
+int handoff_listen(const char *path);
+
+/**
+ * @brief Ждёт новый процесс и отдаёт ему дескрипторы.
+ *
+ * Блокируется на accept(). Если новый процесс не подтвердил приём или
+ * запущен другим пользователем, продолжает ждать следующего — текущий
+ * процесс остаётся в работе.
+ *
+ * @return 0 после успешной передачи, -1 если управляющий сокет закрыт
+ */
+int handoff_serve(int ctl_fd, const int *fds, int count);
+
+#endif
@@ -0,0 +1,564 @@
+// source/server/query/query.c
+#define _POSIX_C_SOURCE 200809L
+
+#include "query.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "../config/serv_config.h"
+
+// Полная запись о сервере — нужна только при выдаче ответа
+typedef struct {
+    char ip[46];
+    int port;
+    uint8_t proto;
+    char country[48];
+    double score;
+    long last_seen;
+    char *config_url;
+} server_rec_t;
+
+// Горячая часть записи: 16 байт, 4 штуки на кеш-линию
+typedef struct {
+    float score;
+    uint32_t last_seen;
+    uint32_t rec;
+    uint16_t country;
+    uint8_t proto;
+    uint8_t pad;
+} hot_t;
+
+typedef struct {
+    hot_t *v;
+    size_t n;
+} part_t;
+
+typedef struct {
+    unsigned long generation;
+
+    server_rec_t *recs;
+    size_t n;
+
+    char (*countries)[48];
+    size_t ncountries;
+    uint16_t *ctab;         // открытая адресация: индекс страны + 1, 0 — пусто
+    size_t ctab_mask;
+
+    part_t all;
+    part_t by_proto[3];
+    part_t *by_country;         // [ncountries]
+    part_t *by_country_proto;   // [ncountries * 3]
+    hot_t *pool;                // общий буфер всех партиций
+} snapshot_t;
+
+typedef struct {
+    int used;
+    unsigned long generation;
+    time_t at;
+    query_filter_t f;
+    size_t n;
+    uint32_t idx[QUERY_MAX_K];
+} cache_slot_t;
+
+struct query_engine {
+    pthread_rwlock_t lock;
+    snapshot_t *snap;
+    unsigned long generation;
+
+    pthread_mutex_t cache_lock;
+    cache_slot_t *cache;
+};
+
+/* ---------- разбор запроса ---------- */
+
+int query_parse(const char *expr, query_filter_t *f) {
+    memset(f, 0, sizeof(*f));
+    f->k = 10;
+
+    while (*expr == ' ') expr++;
+    if (strncasecmp(expr, "TOP", 3) == 0 && (expr[3] == ' ' || expr[3] == '\0' ||
+                                            expr[3] == '\r' || expr[3] == '\n')) {
+        expr += 3;
+    }
+
+    char buf[BUFFER_SIZE];
+    strncpy(buf, expr, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    char *save = NULL;
+    for (char *tok = strtok_r(buf, " \t\r\n", &save); tok; tok = strtok_r(NULL, " \t\r\n", &save)) {
+        char *eq = strchr(tok, '=');
+        if (!eq) {
+            // Голое число — это K
+            char *end;
+            long k = strtol(tok, &end, 10);
+            if (*end != '\0' || k <= 0) return -1;
+            f->k = (size_t)k;
+            continue;
+        }
+
+        *eq = '\0';
+        const char *key = tok;
+        const char *val = eq + 1;
+
+        if (strcmp(key, "country") == 0) {
+            if (strlen(val) >= sizeof(f->country)) return -1;
+            strcpy(f->country, val);
+        } else if (strcmp(key, "proto") == 0) {
+            if (strcasecmp(val, "tcp") == 0) f->proto = QUERY_PROTO_TCP;
+            else if (strcasecmp(val, "udp") == 0) f->proto = QUERY_PROTO_UDP;
+            else if (strcasecmp(val, "any") == 0) f->proto = QUERY_PROTO_ANY;
+            else return -1;
+        } else if (strcmp(key, "min_score") == 0) {
+            f->min_score = atof(val);
+        } else if (strcmp(key, "max_age") == 0) {
+            f->max_age = atol(val);
+            if (f->max_age < 0) return -1;
+        } else if (strcmp(key, "order") == 0) {
+            if (strcmp(val, "score") == 0) f->order = QUERY_ORDER_SCORE;
+            else if (strcmp(val, "fresh") == 0) f->order = QUERY_ORDER_FRESH;
+            else return -1;
+        } else if (strcmp(key, "k") == 0) {
+            long k = atol(val);
+            if (k <= 0) return -1;
+            f->k = (size_t)k;
+        } else {
+            return -1;
+        }
+    }
+
+    if (f->k > QUERY_MAX_K) f->k = QUERY_MAX_K;
+    return 0;
+}
+
+/* ---------- снимок данных ---------- */
+
+static uint32_t country_hash(const char *s) {
+    uint32_t h = 2166136261u;
+    for (; *s; s++) {
+        h ^= (unsigned char)tolower((unsigned char)*s);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Индекс страны в снимке или -1
+static int country_find(const snapshot_t *s, const char *name) {
+    if (!s->ctab) return -1;
+    for (size_t i = country_hash(name) & s->ctab_mask; s->ctab[i]; i = (i + 1) & s->ctab_mask) {
+        if (strcasecmp(s->countries[s->ctab[i] - 1], name) == 0) return s->ctab[i] - 1;
+    }
+    return -1;
+}
+
+static int country_intern(snapshot_t *s, const char *name) {
+    int idx = country_find(s, name);
+    if (idx >= 0) return idx;
+
+    size_t i = country_hash(name) & s->ctab_mask;
+    while (s->ctab[i]) i = (i + 1) & s->ctab_mask;
+
+    idx = (int)s->ncountries++;
+    snprintf(s->countries[idx], sizeof(s->countries[idx]), "%s", name);
+    s->ctab[i] = (uint16_t)(idx + 1);
+    return idx;
+}
+
+static int hot_cmp_score(const void *a, const void *b) {
+    float x = ((const hot_t *)a)->score;
+    float y = ((const hot_t *)b)->score;
+    return (x < y) - (x > y);
+}
+
+static void snapshot_free(snapshot_t *s) {
+    if (!s) return;
+    for (size_t i = 0; i < s->n; i++) free(s->recs[i].config_url);
+    free(s->recs);
+    free(s->countries);
+    free(s->ctab);
+    free(s->by_country);
+    free(s->by_country_proto);
+    free(s->pool);
+    free(s);
+}
+
+// Строит партиции; recs/n уже заполнены
+static int snapshot_build(snapshot_t *s) {
+    size_t cap = 16;
+    while (cap < s->n * 2) cap <<= 1;
+
+    s->ctab = calloc(cap, sizeof(uint16_t));
+    s->ctab_mask = cap - 1;
+    s->countries = calloc(s->n ? s->n : 1, sizeof(*s->countries));
+    s->pool = malloc((s->n ? s->n : 1) * 4 * sizeof(hot_t));
+    if (!s->ctab || !s->countries || !s->pool) return -1;
+
+    hot_t *all = s->pool;
+    for (size_t i = 0; i < s->n; i++) {
+        const server_rec_t *r = &s->recs[i];
+        all[i].score = (float)r->score;
+        all[i].last_seen = (uint32_t)r->last_seen;
+        all[i].rec = (uint32_t)i;
+        all[i].country = (uint16_t)country_intern(s, r->country);
+        all[i].proto = r->proto;
+        all[i].pad = 0;
+    }
+    qsort(all, s->n, sizeof(hot_t), hot_cmp_score);
+    s->all.v = all;
+    s->all.n = s->n;
+
+    s->by_country = calloc(s->ncountries ? s->ncountries : 1, sizeof(part_t));
+    s->by_country_proto = calloc((s->ncountries ? s->ncountries : 1) * 3, sizeof(part_t));
+    if (!s->by_country || !s->by_country_proto) return -1;
+
+    // Подсчёт размеров, затем раскладка по смещениям — порядок по score сохраняется
+    for (size_t i = 0; i < s->n; i++) {
+        s->by_proto[all[i].proto].n++;
+        s->by_country[all[i].country].n++;
+        s->by_country_proto[all[i].country * 3 + all[i].proto].n++;
+    }
+
+    hot_t *cur = s->pool + s->n;
+    for (int p = 0; p < 3; p++) {
+        s->by_proto[p].v = cur;
+        cur += s->by_proto[p].n;
+        s->by_proto[p].n = 0;
+    }
+    for (size_t c = 0; c < s->ncountries; c++) {
+        s->by_country[c].v = cur;
+        cur += s->by_country[c].n;
+        s->by_country[c].n = 0;
+    }
+    for (size_t c = 0; c < s->ncountries * 3; c++) {
+        s->by_country_proto[c].v = cur;
+        cur += s->by_country_proto[c].n;
+        s->by_country_proto[c].n = 0;
+    }
+
+    for (size_t i = 0; i < s->n; i++) {
+        const hot_t h = all[i];
+        part_t *p;
+        p = &s->by_proto[h.proto];
+        p->v[p->n++] = h;
+        p = &s->by_country[h.country];
+        p->v[p->n++] = h;
+        p = &s->by_country_proto[h.country * 3 + h.proto];
+        p->v[p->n++] = h;
+    }
+    return 0;
+}
+
+static const char *hash_field(redisReply *r, const char *name) {
+    for (size_t i = 0; i + 1 < r->elements; i += 2) {
+        if (strcmp(r->element[i]->str, name) == 0) return r->element[i + 1]->str;
+    }
+    return NULL;
+}
+
+/* ---------- движок ---------- */
+
+query_engine_t *query_engine_create(void) {
+    query_engine_t *e = calloc(1, sizeof(*e));
+    if (!e) return NULL;
+
+    e->cache = calloc(QUERY_CACHE_SLOTS, sizeof(cache_slot_t));
+    if (!e->cache) {
+        free(e);
+        return NULL;
+    }
+    pthread_rwlock_init(&e->lock, NULL);
+    pthread_mutex_init(&e->cache_lock, NULL);
+    return e;
+}
+
+long query_engine_load_redis(query_engine_t *e, redisContext *c) {
+    if (!e || !c) return -1;
+
+    // 1. Собираем ключи через SCAN (KEYS блокирует Redis)
+    char **keys = NULL;
+    size_t nkeys = 0, capkeys = 0;
+    char cursor[32] = "0";
+    int complete = 1;
+
+    do {
+        redisReply *reply = redisCommand(c, "SCAN %s MATCH vpn:servers:* COUNT 1000", cursor);
+        if (!reply || reply->type != REDIS_REPLY_ARRAY || reply->elements != 2) {
+            fprintf(stderr, "[-] Query: SCAN failed\n");
+            if (reply) freeReplyObject(reply);
+            for (size_t i = 0; i < nkeys; i++) free(keys[i]);
+            free(keys);
+            return -1;
+        }
+
+        snprintf(cursor, sizeof(cursor), "%s", reply->element[0]->str);
+        redisReply *batch = reply->element[1];
+        for (size_t i = 0; i < batch->elements; i++) {
+            if (nkeys == capkeys) {
+                char **tmp = realloc(keys, (capkeys ? capkeys * 2 : 256) * sizeof(char *));
+                if (!tmp) {
+                    complete = 0;
+                    break;
+                }
+                keys = tmp;
+                capkeys = capkeys ? capkeys * 2 : 256;
+            }
+            keys[nkeys] = strdup(batch->element[i]->str);
+            if (!keys[nkeys]) {
+                complete = 0;
+                break;
+            }
+            nkeys++;
+        }
+        freeReplyObject(reply);
+    } while (complete && strcmp(cursor, "0") != 0);
+
+    // Неполный список ключей дал бы урезанный снимок — оставляем прежний
+    if (!complete) {
+        fprintf(stderr, "[-] Query: out of memory while scanning keys\n");
+        for (size_t i = 0; i < nkeys; i++) free(keys[i]);
+        free(keys);
+        return -1;
+    }
+
+    // 2. HGETALL конвейером — один RTT на всю пачку
+    for (size_t i = 0; i < nkeys; i++) {
+        redisAppendCommand(c, "HGETALL %s", keys[i]);
+    }
+
+    snapshot_t *s = calloc(1, sizeof(*s));
+    if (s) s->recs = calloc(nkeys ? nkeys : 1, sizeof(server_rec_t));
+
+    size_t replies = 0;
+    for (size_t i = 0; i < nkeys; i++) {
+        redisReply *reply = NULL;
+        if (redisGetReply(c, (void **)&reply) != REDIS_OK || !reply) break;
+        replies++;
+
+        // Запись могла истечь по TTL между SCAN и HGETALL
+        if (s && s->recs && reply->type == REDIS_REPLY_ARRAY && reply->elements > 0) {
+            const char *ip = hash_field(reply, "ip");
+            const char *port = hash_field(reply, "port");
+            const char *proto = hash_field(reply, "protocol");
+            const char *country = hash_field(reply, "country");
+            const char *score = hash_field(reply, "score");
+            const char *last_seen = hash_field(reply, "last_seen");
+            const char *url = hash_field(reply, "config_url");
+
+            if (ip && port) {
+                server_rec_t *r = &s->recs[s->n++];
+                snprintf(r->ip, sizeof(r->ip), "%s", ip);
+                r->port = atoi(port);
+                r->proto = proto && strcasecmp(proto, "tcp") == 0 ? QUERY_PROTO_TCP :
+                           proto && strcasecmp(proto, "udp") == 0 ? QUERY_PROTO_UDP : QUERY_PROTO_ANY;
+                snprintf(r->country, sizeof(r->country), "%s", country ? country : "??");
+                r->score = score ? atof(score) : 0.0;
+                r->last_seen = last_seen ? atol(last_seen) : 0;
+                r->config_url = strdup(url ? url : "");
+            }
+        }
+        freeReplyObject(reply);
+    }
+
+    for (size_t i = 0; i < nkeys; i++) free(keys[i]);
+    free(keys);
+
+    // Конвейер оборвался посреди ответов: частичный снимок не публикуем
+    if (replies < nkeys) {
+        fprintf(stderr, "[-] Query: HGETALL pipeline broken after %zu of %zu replies\n", replies, nkeys);
+        snapshot_free(s);
+        return -1;
+    }
+
+    if (!s || !s->recs || snapshot_build(s) != 0) {
+        fprintf(stderr, "[-] Query: snapshot build failed\n");
+        snapshot_free(s);
+        return -1;
+    }
+
+    // 3. Публикуем новое поколение; кеш отвалится сам по номеру поколения
+    pthread_rwlock_wrlock(&e->lock);
+    snapshot_t *old = e->snap;
+    s->generation = ++e->generation;
+    e->snap = s;
+    pthread_rwlock_unlock(&e->lock);
+
+    snapshot_free(old);
+    return (long)s->n;
+}
+
+// Партиция, покрывающая country/proto фильтра; NULL — совпадений быть не может
+static const part_t *pick_partition(const snapshot_t *s, const query_filter_t *f) {
+    if (f->country[0]) {
+        int c = country_find(s, f->country);
+        if (c < 0) return NULL;
+        return f->proto ? &s->by_country_proto[c * 3 + f->proto] : &s->by_country[c];
+    }
+    return f->proto ? &s->by_proto[f->proto] : &s->all;
+}
+
+// Ограниченная min-куча по last_seen
+static void heap_sift_down(hot_t *h, size_t n, size_t i) {
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && h[l].last_seen < h[m].last_seen) m = l;
+        if (r < n && h[r].last_seen < h[m].last_seen) m = r;
+        if (m == i) return;
+        hot_t t = h[i];
+        h[i] = h[m];
+        h[m] = t;
+        i = m;
+    }
+}
+
+static void heap_sift_up(hot_t *h, size_t i) {
+    while (i > 0) {
+        size_t p = (i - 1) / 2;
+        if (h[p].last_seen <= h[i].last_seen) return;
+        hot_t t = h[i];
+        h[i] = h[p];
+        h[p] = t;
+        i = p;
+    }
+}
+
+static size_t run_query(const snapshot_t *s, const query_filter_t *f, time_t now, uint32_t *out) {
+    const part_t *p = pick_partition(s, f);
+    if (!p) return 0;
+
+    size_t cnt = 0;
+    const float min_score = (float)f->min_score;
+
+    if (f->order == QUERY_ORDER_SCORE) {
+        // Партиция уже отсортирована: первые K совпадений и есть ответ
+        for (size_t i = 0; i < p->n && cnt < f->k; i++) {
+            const hot_t *h = &p->v[i];
+            if (h->score < min_score) break;
+            if (f->max_age && now - (time_t)h->last_seen > f->max_age) continue;
+            out[cnt++] = h->rec;
+        }
+        return cnt;
+    }
+
+    hot_t heap[QUERY_MAX_K];
+    for (size_t i = 0; i < p->n; i++) {
+        const hot_t *h = &p->v[i];
+        if (h->score < min_score) break;
+        if (f->max_age && now - (time_t)h->last_seen > f->max_age) continue;
+
+        if (cnt < f->k) {
+            heap[cnt] = *h;
+            heap_sift_up(heap, cnt++);
+        } else if (h->last_seen > heap[0].last_seen) {
+            heap[0] = *h;
+            heap_sift_down(heap, cnt, 0);
+        }
+    }
+
+    // Выгружаем кучу в порядке убывания last_seen
+    for (size_t n = cnt; n > 0; n--) {
+        out[n - 1] = heap[0].rec;
+        heap[0] = heap[n - 1];
+        heap_sift_down(heap, n - 1, 0);
+    }
+    return cnt;
+}
+
+static size_t cache_slot(const query_filter_t *f) {
+    const unsigned char *b = (const unsigned char *)f;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < sizeof(*f); i++) {
+        h ^= b[i];
+        h *= 16777619u;
+    }
+    return h % QUERY_CACHE_SLOTS;
+}
+
+size_t query_engine_run(query_engine_t *e, const query_filter_t *f, char *out, size_t outlen) {
+    if (!out || outlen == 0) return 0;
+
+    // Нормализуем фильтр, чтобы байтовое сравнение в кеше было корректным
+    query_filter_t nf;
+    memset(&nf, 0, sizeof(nf));
+    snprintf(nf.country, sizeof(nf.country), "%s", f->country);
+    for (char *p = nf.country; *p; p++) *p = (char)tolower((unsigned char)*p);
+    nf.proto = f->proto;
+    nf.min_score = f->min_score;
+    nf.max_age = f->max_age;
+    nf.order = f->order;
+    nf.k = f->k > QUERY_MAX_K ? QUERY_MAX_K : f->k;
+
+    time_t now = time(NULL);
+    uint32_t idx[QUERY_MAX_K];
+    size_t n = 0;
+
+    pthread_rwlock_rdlock(&e->lock);
+    const snapshot_t *s = e->snap;
+
+    if (s) {
+        cache_slot_t *slot = &e->cache[cache_slot(&nf)];
+        int hit = 0;
+
+        pthread_mutex_lock(&e->cache_lock);
+        // Фильтр с max_age зависит от текущего времени — такой результат живёт секунду
+        if (slot->used && slot->generation == s->generation &&
+            (nf.max_age == 0 || slot->at == now) &&
+            memcmp(&slot->f, &nf, sizeof(nf)) == 0) {
+            n = slot->n;
+            memcpy(idx, slot->idx, n * sizeof(uint32_t));
+            hit = 1;
+        }
+        pthread_mutex_unlock(&e->cache_lock);
+
+        if (!hit) {
+            n = run_query(s, &nf, now, idx);
+
+            pthread_mutex_lock(&e->cache_lock);
+            slot->used = 1;
+            slot->generation = s->generation;
+            slot->at = now;
+            slot->f = nf;
+            slot->n = n;
+            memcpy(slot->idx, idx, n * sizeof(uint32_t));
+            pthread_mutex_unlock(&e->cache_lock);
+        }
+    }
+
+    static const char *proto_names[] = {"any", "tcp", "udp"};
+    size_t len = 0;
+    size_t written = 0;
+    for (size_t i = 0; i < n; i++) {
+        const server_rec_t *r = &s->recs[idx[i]];
+        int w = snprintf(out + len, outlen - len, "%s %d %s %s %.2f %ld %s\n",
+                         r->ip, r->port, proto_names[r->proto], r->country,
+                         r->score, r->last_seen, r->config_url);
+        if (w < 0 || (size_t)w >= outlen - len) break;
+        len += (size_t)w;
+        written++;
+    }
+    pthread_rwlock_unlock(&e->lock);
+
+    int w = snprintf(out + len, outlen - len, "END %zu\n", written);
+    if (w > 0 && (size_t)w < outlen - len) len += (size_t)w;
+    return len;
+}
+
+unsigned long query_engine_generation(query_engine_t *e) {
+    pthread_rwlock_rdlock(&e->lock);
+    unsigned long g = e->generation;
+    pthread_rwlock_unlock(&e->lock);
+    return g;
+}
+
+void query_engine_free(query_engine_t *e) {
+    if (!e) return;
+    snapshot_free(e->snap);
+    free(e->cache);
+    pthread_rwlock_destroy(&e->lock);
+    pthread_mutex_destroy(&e->cache_lock);
+    free(e);
+}
@@ -0,0 +1,84 @@
+// source/server/query/query.h
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <stddef.h>
+#include <time.h>
+#include <hiredis/hiredis.h>
+
+/**
+ * @brief Движок top-K запросов по набору серверов внутри процесса server.
+ *
+ * Снимок данных (generation) строится из Redis целиком и после публикации
+ * не меняется. В снимке заранее построены партиции, отсортированные по score:
+ * все серверы, по протоколу, по стране и по паре страна+протокол. Запрос по
+ * score — это проход по нужной партиции до первых K совпадений. Для прочих
+ * порядков (order=fresh) используется ограниченная куча на K элементов.
+ *
+ * Результаты кешируются по нормализованному фильтру; кеш сбрасывается
+ * автоматически при смене поколения данных.
+ */
+
+typedef enum {
+    QUERY_PROTO_ANY = 0,
+    QUERY_PROTO_TCP,
+    QUERY_PROTO_UDP,
+} query_proto_t;
+
+typedef enum {
+    QUERY_ORDER_SCORE = 0,  // по убыванию score
+    QUERY_ORDER_FRESH,      // по убыванию last_seen
+} query_order_t;
+
+/**
+ * @brief Фильтр запроса.
+ *
+ * Текстовая форма: "TOP <k> [country=JP] [proto=udp] [min_score=50]
+ * [max_age=3600] [order=score|fresh]".
+ */
+typedef struct {
+    char country[48];       // пусто — любая страна
+    int proto;              // query_proto_t
+    double min_score;
+    long max_age;           // секунды от last_seen, 0 — без ограничения
+    int order;              // query_order_t
+    size_t k;
+} query_filter_t;
+
+typedef struct query_engine query_engine_t;
+
+/**
+ * @brief Разбирает текстовый запрос в фильтр.
+ * @return 0 при успехе, -1 при синтаксической ошибке
+ */
+int query_parse(const char *expr, query_filter_t *f);
+
+/**
+ * @brief Создаёт пустой движок (поколение 0, без данных).
+ */
+query_engine_t *query_engine_create(void);
+
+/**
+ * @brief Перечитывает vpn:servers:* из Redis и публикует новое поколение.
+ * @return число загруженных серверов или -1 при ошибке
+ */
+long query_engine_load_redis(query_engine_t *e, redisContext *c);
+
+/**
+ * @brief Выполняет запрос и пишет ответ в out (по строке на сервер).
+ *
+ * Формат строки: "<ip> <port> <proto> <country> <score> <last_seen> <config_url>\n",
+ * в конце — "END <n>\n".
+ *
+ * @return длина ответа в байтах (без завершающего нуля)
+ */
+size_t query_engine_run(query_engine_t *e, const query_filter_t *f, char *out, size_t outlen);
+
+/**
+ * @brief Текущее поколение данных.
+ */
+unsigned long query_engine_generation(query_engine_t *e);
+
+void query_engine_free(query_engine_t *e);
+
+#endif
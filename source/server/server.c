@@ -1,68 +1,149 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <pthread.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <time.h>
 #include "config/serv_config.h"
+#include "query/query.h"
+#include "handoff/handoff.h"
+#include "../../database/redis/utils/redis_store.h"
 
 volatile sig_atomic_t stop_server = 0;
+volatile sig_atomic_t handed_off = 0;
 int server_fd;
+int handoff_fd = -1;
 pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t clients_cond = PTHREAD_COND_INITIALIZER;
 int active_clients = 0;
+query_engine_t *engine;
+char handoff_sock_path[108];
+
+// Соединения клиентов: при передаче сокета простаивающие закрываем на чтение,
+// занятые — сразу после ответа на текущий запрос
+typedef struct {
+    int fd;         // -1 — слот свободен
+    int busy;       // обрабатывается запрос
+} client_slot_t;
+
+client_slot_t clients[MAX_CLIENTS];
+int draining = 0;
 
 void *client_handler(void *arg);
+void *refresh_handler(void *arg);
+void *handoff_handler(void *arg);
 void handle_sigint(int sig);
 
-int main() {
+int main(int argc, char *argv[]) {
     struct sockaddr_in address;
     socklen_t addrlen = sizeof(address);
+    int hot_restart = argc > 1 && strcmp(argv[1], "--hot-restart") == 0;
 
     signal(SIGINT, handle_sigint); // Обработка Ctrl+C
 
-    // Создание сокета
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
-        perror("Socket failed");
-        exit(EXIT_FAILURE);
+    for (int i = 0; i < MAX_CLIENTS; i++) clients[i].fd = -1;
+
+    int have_handoff_path = handoff_path(handoff_sock_path, sizeof(handoff_sock_path)) == 0;
+
+    int inherited[HANDOFF_MAX_FDS];
+    int inherited_count = hot_restart && have_handoff_path ? handoff_receive(handoff_sock_path, inherited) : -1;
+
+    if (inherited_count > 0) {
+        // Сокет уже слушает — принимаем соединения сразу, без bind/listen
+        server_fd = inherited[0];
+        for (int i = 1; i < inherited_count; i++) close(inherited[i]);
+        printf("Took over listening socket from previous server\n");
+    } else {
+        if (hot_restart) {
+            fprintf(stderr, "No running server to take over, starting cold\n");
+        }
+
+        // Создание сокета
+        if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+            perror("Socket failed");
+            exit(EXIT_FAILURE);
+        }
+
+        // Настройка адреса сервера
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = INADDR_ANY;
+        address.sin_port = htons(SERVER_PORT);
+
+        // Привязка сокета
+        if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+            perror("Bind failed");
+            close(server_fd);
+            exit(EXIT_FAILURE);
+        }
+
+        // Прослушивание порта
+        if (listen(server_fd, MAX_PENDING) < 0) {
+            perror("Listen failed");
+            close(server_fd);
+            exit(EXIT_FAILURE);
+        }
     }
 
-    // Настройка адреса сервера
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(SERVER_PORT);
+    // Во время передачи accept() на сокете делают оба процесса — блокироваться нельзя
+    fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL) | O_NONBLOCK);
 
-    // Привязка сокета
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
-        perror("Bind failed");
-        close(server_fd);
-        exit(EXIT_FAILURE);
+    handoff_fd = have_handoff_path ? handoff_listen(handoff_sock_path) : -1;
+    pthread_t handoff_thread;
+    if (handoff_fd >= 0 && pthread_create(&handoff_thread, NULL, handoff_handler, NULL) == 0) {
+        pthread_detach(handoff_thread);
+    } else {
+        fprintf(stderr, "Hot restart disabled: handoff socket unavailable\n");
     }
 
-    // Прослушивание порта
-    if (listen(server_fd, MAX_PENDING) < 0) {
-        perror("Listen failed");
+    engine = query_engine_create();
+    if (!engine) {
+        fprintf(stderr, "Failed to create query engine\n");
         close(server_fd);
         exit(EXIT_FAILURE);
     }
 
+    pthread_t refresh_thread;
+    if (pthread_create(&refresh_thread, NULL, refresh_handler, NULL) != 0) {
+        perror("Failed to create refresh thread");
+    } else {
+        pthread_detach(refresh_thread);
+    }
+
     printf("Server is listening on port %d...\n", SERVER_PORT);
 
     while (!stop_server) {
+        struct pollfd pfd = { .fd = server_fd, .events = POLLIN };
+        if (poll(&pfd, 1, 1000) <= 0) continue;
+
+        addrlen = sizeof(address);
         int new_socket = accept(server_fd, (struct sockaddr *)&address, &addrlen);
         if (new_socket < 0) {
             if (stop_server) break; // Завершение работы
+            // Соединение забрал другой процесс, пока идёт передача
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
             perror("Accept failed");
             continue;
         }
 
         pthread_mutex_lock(&clients_mutex);
-        if (active_clients >= MAX_CLIENTS) {
+        int slot = -1;
+        for (int i = 0; i < MAX_CLIENTS && slot < 0; i++) {
+            if (clients[i].fd < 0) slot = i;
+        }
+        if (slot < 0) {
             pthread_mutex_unlock(&clients_mutex);
             printf("Max clients reached. Connection refused.\n");
             close(new_socket);
             continue;
         }
+        clients[slot].fd = new_socket;
+        clients[slot].busy = 0;
         active_clients++;
         pthread_mutex_unlock(&clients_mutex);
 
@@ -71,13 +152,14 @@ int main() {
 
         pthread_t thread_id;
         int *pclient = malloc(sizeof(int));
-        *pclient = new_socket;
+        if (pclient) *pclient = slot;
 
-        if (pthread_create(&thread_id, NULL, client_handler, pclient) != 0) {
+        if (!pclient || pthread_create(&thread_id, NULL, client_handler, pclient) != 0) {
             perror("Failed to create thread");
             free(pclient);
             close(new_socket);
             pthread_mutex_lock(&clients_mutex);
+            clients[slot].fd = -1;
             active_clients--;
             pthread_mutex_unlock(&clients_mutex);
         } else {
@@ -85,38 +167,146 @@ int main() {
         }
     }
 
-    printf("Server shutting down...\n");
+    // Копию сокета держит новый процесс — закрываем только свою
     close(server_fd);
+
+    if (handed_off) {
+        printf("Listening socket handed off, draining %d connections...\n", active_clients);
+
+        // Простаивающие keep-alive соединения иначе висели бы в recv() до таймаута:
+        // SHUT_RD будит recv() с нулём, и обработчик закрывает соединение штатно
+        pthread_mutex_lock(&clients_mutex);
+        draining = 1;
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            if (clients[i].fd >= 0 && !clients[i].busy) shutdown(clients[i].fd, SHUT_RD);
+        }
+        pthread_mutex_unlock(&clients_mutex);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += DRAIN_TIMEOUT_SEC;
+
+        pthread_mutex_lock(&clients_mutex);
+        while (active_clients > 0) {
+            if (pthread_cond_timedwait(&clients_cond, &clients_mutex, &deadline) == ETIMEDOUT) {
+                printf("Drain timeout, %d connections left\n", active_clients);
+                break;
+            }
+        }
+        pthread_mutex_unlock(&clients_mutex);
+    } else if (handoff_fd >= 0) {
+        // Путь управляющего сокета наш — при обычной остановке убираем его
+        close(handoff_fd);
+        unlink(handoff_sock_path);
+    }
+
+    printf("Server shutting down...\n");
     return 0;
 }
 
+// Запрос обработан: соединение снова простаивает. Возвращает 0, если идёт передача
+// сокета и соединение пора закрыть
+static int client_idle(int slot) {
+    pthread_mutex_lock(&clients_mutex);
+    clients[slot].busy = 0;
+    int keep = !draining;
+    pthread_mutex_unlock(&clients_mutex);
+    return keep;
+}
+
 void *client_handler(void *arg) {
-    int client_socket = *((int *)arg);
+    int slot = *((int *)arg);
     free(arg);
+    int client_socket = clients[slot].fd;
 
     char buffer[BUFFER_SIZE];
     int bytes_read;
 
     while ((bytes_read = recv(client_socket, buffer, BUFFER_SIZE - 1, 0)) > 0) {
+        pthread_mutex_lock(&clients_mutex);
+        clients[slot].busy = 1;
+        pthread_mutex_unlock(&clients_mutex);
+
         buffer[bytes_read] = '\0';
         printf("Received from client: %s", buffer);
 
+        if (strncasecmp(buffer, "TOP", 3) == 0) {
+            query_filter_t filter;
+            if (query_parse(buffer, &filter) != 0) {
+                const char *err = "ERR bad query\n";
+                send(client_socket, err, strlen(err), 0);
+                if (!client_idle(slot)) break;
+                continue;
+            }
+
+            char *response = malloc(RESPONSE_SIZE);
+            if (!response) break;
+            size_t len = query_engine_run(engine, &filter, response, RESPONSE_SIZE);
+            send(client_socket, response, len, 0);
+            free(response);
+            if (!client_idle(slot)) break;
+            continue;
+        }
+
         send(client_socket, buffer, bytes_read, 0);
+        if (!client_idle(slot)) break;
     }
 
     printf("Client disconnected. Active clients before decrement: %d\n", active_clients);
     close(client_socket);
 
     pthread_mutex_lock(&clients_mutex);
+    clients[slot].fd = -1;
     active_clients--;
+    pthread_cond_signal(&clients_cond);
     pthread_mutex_unlock(&clients_mutex);
 
     return NULL;
 }
 
+// Ждёт новый бинарник на управляющем сокете и отдаёт ему слушающий сокет
+void *handoff_handler(void *arg) {
+    (void)arg;
+
+    if (handoff_serve(handoff_fd, &server_fd, 1) == 0) {
+        printf("Hot restart: new server took over\n");
+        close(handoff_fd);
+        handoff_fd = -1;
+        handed_off = 1;
+        stop_server = 1;
+    }
+    return NULL;
+}
+
+// Периодически перечитывает серверы из Redis и публикует новое поколение данных
+void *refresh_handler(void *arg) {
+    (void)arg;
+    redisContext *redis = NULL;
+
+    while (!stop_server) {
+        if (!redis) redis = redis_connect();
+
+        if (redis) {
+            long n = query_engine_load_redis(engine, redis);
+            if (n < 0) {
+                // Скорее всего, соединение разорвано — переподключимся на следующем круге
+                redisFree(redis);
+                redis = NULL;
+            } else {
+                printf("Query data refreshed: %ld servers, generation %lu\n",
+                       n, query_engine_generation(engine));
+            }
+        }
+
+        sleep(QUERY_REFRESH_SEC);
+    }
+
+    if (redis) redisFree(redis);
+    return NULL;
+}
+
 void handle_sigint(int sig) {
     (void)sig;
     stop_server = 1;
-    close(server_fd);
     printf("\nSIGINT received, stopping server...\n");
 }